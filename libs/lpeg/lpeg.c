@@ -28,11 +28,25 @@
 #include "lauxlib.h"
 
 
-/* maximum call/backtrack levels */
+/* maximum call/backtrack levels when verifying a grammar */
 #define MAXBACK		400
 
-/* initial size for capture's list */
-#define IMAXCAPTURES	600
+/* initial size (on the C stack) for the call/backtrack stack of a match */
+#define INITBACK	100
+
+/* default maximum call/backtrack levels of a match (see lpeg.setmaxstack) */
+#define MAXSTACK	10000
+
+/* maximum jumps followed when computing the first chars of a pattern */
+#define MAXHEADDEPTH	32
+
+/* initial size (on the C stack) for capture's list */
+#define IMAXCAPTURES	100
+
+/* registry keys: maximum stack size and heap buffers kept between matches */
+#define MAXSTACKKEY	"lpeg-maxstack"
+#define STACKKEY	"lpeg-stack"
+#define CAPLISTKEY	"lpeg-captures"
 
 
 /* index, on Lua stack, for subject */
@@ -47,6 +61,9 @@
 /* index, on Lua stack, for pattern's fenv */
 #define PENVIDX		(CAPLISTIDX + 1)
 
+/* index, on Lua stack, for heap-allocated call/backtrack stack (or nil) */
+#define STACKIDX	(PENVIDX + 1)
+
 
 
 typedef unsigned char byte;
@@ -135,6 +152,10 @@ static const Instruction giveup = {{IGiveup, 0, 0}};
 
 #define dest(p,x)	((x) + ((p)+(x))->i.offset)
 
+/* a span whose set misses only one char keeps that char (plus 1) in
+   'offset', so that it can be found with memchr */
+#define getstopchar(op)	((op)->i.offset - 1)
+
 #define MAXOFF		0xF
 
 #define isprop(op,p)	(opproperties[(op)->i.code] & (p))
@@ -364,15 +385,85 @@ static Capture *doublecap (lua_State *L, Capture *cap, int captop) {
 }
 
 
+static int getmaxstack (lua_State *L) {
+  int max;
+  lua_getfield(L, LUA_REGISTRYINDEX, MAXSTACKKEY);
+  max = lua_isnumber(L, -1) ? (int)lua_tointeger(L, -1) : MAXSTACK;
+  lua_pop(L, 1);
+  return max;
+}
+
+
+/*
+** Moves the call/backtrack stack to a larger block. The block is a userdata
+** at STACKIDX, which may already be big enough when reused from a previous
+** match. Returns the new base and updates 'stacklimit'.
+*/
+static Stack *doublestack (lua_State *L, Stack *stackbase,
+                           Stack **stacklimit) {
+  int n = *stacklimit - stackbase;
+  int max = getmaxstack(L);
+  int newn;
+  Stack *newstack;
+  if (n >= max)
+    luaL_error(L, "too many pending calls/choices");
+  newn = (n > max / 2) ? max : 2 * n;
+  if (lua_isuserdata(L, STACKIDX) &&
+      lua_touserdata(L, STACKIDX) != (void *)stackbase &&
+      lua_objlen(L, STACKIDX) >= newn * sizeof(Stack)) {
+    newstack = (Stack *)lua_touserdata(L, STACKIDX);
+    newn = lua_objlen(L, STACKIDX) / sizeof(Stack);
+    memcpy(newstack, stackbase, n * sizeof(Stack));
+  }
+  else {
+    newstack = (Stack *)lua_newuserdata(L, newn * sizeof(Stack));
+    memcpy(newstack, stackbase, n * sizeof(Stack));
+    lua_replace(L, STACKIDX);
+  }
+  *stacklimit = newstack + newn;
+  return newstack;
+}
+
+
+/*
+** State of a match that may stop for more input (see streams). Its stack
+** is the userdata at STACKIDX; the subject may grow while 'eof' is false.
+*/
+typedef struct Resume {
+  const Instruction *p;  /* where to resume (NULL: start the match) */
+  int stacktop;  /* number of stack entries in use */
+  int captop;
+  int eof;
+  int suspended;  /* set when the match stops for lack of input */
+} Resume;
+
+
+#define canwait(rs)	((rs) != NULL && !(rs)->eof)
+
+
 static const char *match (lua_State *L, const char *o, const char *s,
-                          const char *e, Instruction *op, Capture *capture) {
-  Stack stackbase[MAXBACK];
-  Stack *stacklimit = stackbase + MAXBACK;
-  Stack *stack = stackbase;  /* point to first empty slot in stack */
-  int capsize = IMAXCAPTURES;
+                          const char *e, Instruction *op, Capture *capture,
+                          int capsize, Resume *rs) {
+  Stack stackinit[INITBACK];
+  Stack *stackbase = stackinit;
+  Stack *stacklimit = stackinit + INITBACK;
+  Stack *stack;  /* point to first empty slot in stack */
   int captop = 0;  /* point to first empty slot in captures */
   const Instruction *p = op;
-  stack->p = &giveup; stack->s = s; stack->caplevel = 0; stack++;
+  if (rs != NULL) {
+    stackbase = (Stack *)lua_touserdata(L, STACKIDX);
+    stacklimit = stackbase + lua_objlen(L, STACKIDX) / sizeof(Stack);
+    rs->suspended = 0;
+  }
+  stack = stackbase;
+  if (rs != NULL && rs->p != NULL) {
+    p = rs->p;
+    stack += rs->stacktop;
+    captop = rs->captop;
+  }
+  else {
+    stack->p = &giveup; stack->s = s; stack->caplevel = 0; stack++;
+  }
   for (;;) {
 #if defined(DEBUG)
       printf("s: |%s| stck: %d c: %d  ", s, stack - stackbase, captop);
@@ -396,47 +487,71 @@ static const char *match (lua_State *L, const char *o, const char *s,
       }
       case IAny: {
         int n = p->i.aux;
-        if (n > e - s) goto fail;
+        if (n > e - s) {
+          if (canwait(rs)) goto suspend;
+          goto fail;
+        }
         else { p++; s += n; }
         continue;
       }
       case ITestAny: {
         int n = p->i.aux;
-        if (n > e - s) p += p->i.offset;
+        if (n > e - s) {
+          if (canwait(rs)) goto suspend;
+          p += p->i.offset;
+        }
         else { p++; s += n; }
         continue;
       }
       case IChar: {
-        if ((byte)*s != p->i.aux || s >= e) goto fail;
+        if ((byte)*s != p->i.aux || s >= e) {
+          if (s >= e && canwait(rs)) goto suspend;
+          goto fail;
+        }
         else { p++; s++; }
         continue;
       }
       case ITestChar: {
-        if ((byte)*s != p->i.aux || s >= e) p += p->i.offset;
+        if ((byte)*s != p->i.aux || s >= e) {
+          if (s >= e && canwait(rs)) goto suspend;
+          p += p->i.offset;
+        }
         else { p++; s++; }
         continue;
       }
       case ISet: {
         int c = (unsigned char)*s;
-        if (!testchar((p+1)->buff, c)) goto fail;
+        if (!testchar((p+1)->buff, c)) {
+          if (s >= e && canwait(rs)) goto suspend;
+          goto fail;
+        }
         else { p += CHARSETINSTSIZE; s++; }
         continue;
       }
       case ITestSet: {
         int c = (unsigned char)*s;
-        if (!testchar((p+1)->buff, c)) p += p->i.offset;
+        if (!testchar((p+1)->buff, c)) {
+          if (s >= e && canwait(rs)) goto suspend;
+          p += p->i.offset;
+        }
         else { p += CHARSETINSTSIZE; s++; }
         continue;
       }
       case IZSet: {
         int c = (unsigned char)*s;
-        if (!testchar((p+1)->buff, c) || s >= e) goto fail;
+        if (!testchar((p+1)->buff, c) || s >= e) {
+          if (s >= e && canwait(rs)) goto suspend;
+          goto fail;
+        }
         else { p += CHARSETINSTSIZE; s++; }
         continue;
       }
       case ITestZSet: {
         int c = (unsigned char)*s;
-        if (!testchar((p+1)->buff, c) || s >= e) p += p->i.offset;
+        if (!testchar((p+1)->buff, c) || s >= e) {
+          if (s >= e && canwait(rs)) goto suspend;
+          p += p->i.offset;
+        }
         else { p += CHARSETINSTSIZE; s++; }
         continue;
       }
@@ -445,26 +560,37 @@ static const char *match (lua_State *L, const char *o, const char *s,
           int c = (unsigned char)*s;
           if (!testchar((p+1)->buff, c)) break;
         }
+        if (s >= e && canwait(rs)) goto suspend;
         p += CHARSETINSTSIZE;
         continue;
       }
       case ISpanZ: {
-        for (; s < e; s++) {
-          int c = (unsigned char)*s;
-          if (!testchar((p+1)->buff, c)) break;
+        if (p->i.offset != 0) {  /* set has a single stop char? */
+          const char *r = (const char *)memchr(s, getstopchar(p), e - s);
+          s = (r != NULL) ? r : e;
         }
+        else {
+          for (; s < e; s++) {
+            int c = (unsigned char)*s;
+            if (!testchar((p+1)->buff, c)) break;
+          }
+        }
+        if (s >= e && canwait(rs)) goto suspend;
         p += CHARSETINSTSIZE;
         continue;
       }
       case IFunc: {
         const char *r = (p+1)->f((p+2)->buff, o, s, e);
         if (r == NULL) goto fail;
+        if (r >= e && canwait(rs)) goto suspend;
         s = r;
         p += p->i.offset;
         continue;
       }
       case ILFunc: {
         lua_Integer res;
+        if (rs != NULL)
+          luaL_error(L, "match-time function in a stream");
         lua_rawgeti(L, PENVIDX, p->i.offset);  /* push function */
         lua_pushvalue(L, SUBJIDX);  /* push original subject */
         lua_pushinteger(L, s - o + 1);  /* current position */
@@ -481,8 +607,11 @@ static const char *match (lua_State *L, const char *o, const char *s,
         continue;
       }
       case IChoice: {
-        if (stack >= stacklimit)
-          return (luaL_error(L, "too many pending calls/choices"), (char *)0);
+        if (stack >= stacklimit) {
+          Stack *newbase = doublestack(L, stackbase, &stacklimit);
+          stack = newbase + (stack - stackbase);
+          stackbase = newbase;
+        }
         stack->p = dest(0, p);
         stack->s = s - p->i.aux;
         stack->caplevel = captop;
@@ -491,8 +620,11 @@ static const char *match (lua_State *L, const char *o, const char *s,
         continue;
       }
       case ICall: {
-        if (stack >= stacklimit)
-          return (luaL_error(L, "too many pending calls/choices"), (char *)0);
+        if (stack >= stacklimit) {
+          Stack *newbase = doublestack(L, stackbase, &stacklimit);
+          stack = newbase + (stack - stackbase);
+          stackbase = newbase;
+        }
         stack->s = NULL;
         stack->p = p + 1;  /* save return address */
         stack++;
@@ -571,6 +703,13 @@ static const char *match (lua_State *L, const char *o, const char *s,
       default: assert(0); return NULL;
     }
   }
+  suspend: {  /* instruction 'p' needs more input: save state */
+    rs->p = p;
+    rs->stacktop = stack - stackbase;
+    rs->captop = captop;
+    rs->suspended = 1;
+    return s;
+  }
 }
 
 /* }====================================================== */
@@ -1424,6 +1563,20 @@ static int union_l (lua_State *L) {
 }
 
 
+static int setspan (Instruction *p, const Charset cs) {
+  int c, nstops = 0, stop = 0;
+  setinst(p, ISpan, 0);
+  loopset(k, p[1].buff[k] = cs[k]);
+  correctset(p);
+  for (c = 0; c <= UCHAR_MAX && nstops < 2; c++) {
+    if (!testchar(cs, c)) { stop = c; nstops++; }
+  }
+  if (p->i.code == ISpanZ && nstops == 1)
+    p->i.offset = stop + 1;  /* see 'getstopchar' */
+  return CHARSETINSTSIZE;
+}
+
+
 static int repeatcharset (lua_State *L, Charset cs, int l1, int n) {
   /* e; ...; e; span; */
   int i;
@@ -1431,13 +1584,85 @@ static int repeatcharset (lua_State *L, Charset cs, int l1, int n) {
   for (i = 0; i < n; i++) {
     p += addpatt(L, p, 1);
   }
-  setinst(p, ISpan, 0);
-  loopset(k, p[1].buff[k] = cs[k]);
-  correctset(p);
+  setspan(p, cs);
   return 1;
 }
 
 
+/*
+** Adds to 'cs' the chars that may start a match of 'p', following tests
+** and choices up to the first check in each path. Returns 0 if some path
+** may do anything else before checking a char.
+*/
+static int headset (const Instruction *p, Charset cs, int depth) {
+  Charset cs1;
+  for (; depth < MAXHEADDEPTH; depth++) {
+    switch ((Opcode)p->i.code) {
+      case IChar: case ISet: case IZSet: {
+        fillcharset((Instruction *)p, cs1);
+        loopset(i, cs[i] |= cs1[i]);
+        return 1;
+      }
+      case ITestChar: case ITestSet: case ITestZSet: {
+        fillcharset((Instruction *)p, cs1);
+        loopset(i, cs[i] |= cs1[i]);
+        p += p->i.offset;  /* other chars go to the test's target */
+        break;
+      }
+      case IChoice: {
+        if (p->i.aux != 0 || !headset(dest(0, p), cs, depth + 1))
+          return 0;
+        p++;
+        break;
+      }
+      case IJmp: {
+        p += p->i.offset;
+        break;
+      }
+      case IFail:
+        return 1;  /* this path cannot match anything */
+      case IOpenCapture: case ICloseCapture:
+      case IEmptyCapture: case IFullCapture: {
+        p++;
+        break;
+      }
+      default: return 0;
+    }
+  }
+  return 0;
+}
+
+
+/*
+** Checks whether loop body 'p1' is an idiom such as '1 - p' or 'p + 1',
+** which just consumes any char outside the first-char set of 'p'. If so,
+** fills 'cs' with those chars: a span over 'cs' is equivalent to any
+** number of iterations of 'p1', and searching loops skip uninteresting
+** parts of the subject without going through the whole body for each char.
+*/
+static int skipset (Instruction *p1, int l1, Charset cs) {
+  Charset head, cs1;
+  Instruction *p = p1;
+  Instruction *last = p1 + l1 - 1;
+  if (l1 < 2 || last->i.code != IAny || last->i.aux != 1)
+    return 0;
+  loopset(i, head[i] = 0);
+  while (istest(p) && p < last) {  /* chain of alternatives */
+    fillcharset(p, cs1);
+    loopset(i, head[i] |= cs1[i]);
+    p += p->i.offset;
+  }
+  if (p == last) {}  /* all alternatives fail with other chars */
+  else if (p->i.code == IChoice && dest(0, p) == last && p->i.aux == 0) {
+    if (!headset(p + 1, head, 0)) return 0;
+  }
+  else return 0;
+  loopset(i, cs[i] = ~head[i]);
+  loopset(i, if (cs[i] != 0) return 1);
+  return 0;  /* body may not skip any char */
+}
+
+
 static Instruction *repeatheadfail (lua_State *L, int l1, int n) {
   /* e; ...; e; L2: e'(L1); jump L2; L1: ... */
   int i;
@@ -1455,17 +1680,23 @@ static Instruction *repeatheadfail (lua_State *L, int l1, int n) {
 
 static Instruction *repeats (lua_State *L, Instruction *p1, int l1, int n) {
   /* e; ...; e; choice L1; L2: e; partialcommit L2; L1: ... */
+  /* or e; ...; e; span; choice L1; L2: e; span; partialcommit L2; L1: ... */
   int i;
-  Instruction *op = newpatt(L, (n + 1)*l1 + 2);
+  Charset cs;
+  int skip = skipset(p1, l1, cs);
+  int ls = skip ? CHARSETINSTSIZE : 0;
+  Instruction *op = newpatt(L, (n + 1)*l1 + 2 + 2*ls);
   Instruction *p = op;
   if (!verify(L, p1, p1, p1 + l1, 0, 0))
     luaL_error(L, "loop body may accept empty string");
   for (i = 0; i < n; i++) {
     p += addpatt(L, p, 1);
   }
-  setinst(p++, IChoice, 1 + l1 + 1);
+  if (skip) p += setspan(p, cs);
+  setinst(p++, IChoice, 1 + l1 + ls + 1);
   p += addpatt(L, p, 1);
-  setinst(p, IPartialCommit, -l1);
+  if (skip) p += setspan(p, cs);
+  setinst(p, IPartialCommit, -(l1 + ls));
   return op;
 }
 
@@ -1647,6 +1878,7 @@ typedef struct CapState {
   Capture *cap;  /* current capture */
   lua_State *L;
   const char *s;  /* original string */
+  size_t offset;  /* position of 's' in the whole subject (streams) */
   int valuecached;  /* value stored in cache slot */
 } CapState;
 
@@ -1704,11 +1936,31 @@ static int simplecap (CapState *cs) {
 }
 
 
+/*
+** Number of captures directly nested in open capture 'cap'; each one
+** pushes at least one value in the common case, so it sizes the table
+*/
+static int nestedcaps (Capture *cap) {
+  int n = 0;
+  int depth = 0;
+  for (cap++; depth > 0 || !isclosecap(cap); cap++) {
+    if (depth == 0) n++;
+    if (isclosecap(cap)) depth--;
+    else if (!isfullcap(cap)) depth++;
+  }
+  return n;
+}
+
+
 static int tablecap (CapState *cs) {
   int n = 0;
-  lua_newtable(cs->L);
-  if (isfullcap(cs->cap++))
+  if (isfullcap(cs->cap)) {
+    lua_newtable(cs->L);
+    cs->cap++;
     return 1;  /* table is empty */
+  }
+  lua_createtable(cs->L, nestedcaps(cs->cap), 0);
+  cs->cap++;
   while (!isclosecap(cs->cap)) {
     int i;
     int k = pushcapture(cs);
@@ -1843,7 +2095,7 @@ static int pushcapture (CapState *cs) {
   luaL_checkstack(cs->L, 4, "too many unstored captures");
   switch (captype(cs->cap)) {
     case Cposition: {
-      lua_pushinteger(cs->L, cs->cap->s - cs->s + 1);
+      lua_pushinteger(cs->L, cs->cap->s - cs->s + cs->offset + 1);
       cs->cap++;
       return 1;
     }
@@ -1887,7 +2139,7 @@ static int getcaptures (lua_State *L, const char *s, const char *r) {
   Capture *capture = (Capture *)lua_touserdata(L, CAPLISTIDX);
   CapState cs;
   int n = 0;
-  cs.cap = capture; cs.L = L; cs.s = s; cs.valuecached = 0;
+  cs.cap = capture; cs.L = L; cs.s = s; cs.offset = 0; cs.valuecached = 0;
   while (!isclosecap(cs.cap))
     n += pushcapture(&cs);
   if (n == 0) {  /* no captures? */
@@ -1921,10 +2173,33 @@ static int printpat_l (lua_State *L) {
 }
 
 
+/*
+** Heap buffers grown by a match are kept in the registry for the next match
+** on the same state. A match takes them out of the registry while it runs,
+** so that a nested match (from a function capture) gets buffers of its own.
+*/
+static void takebuffer (lua_State *L, const char *key) {
+  lua_getfield(L, LUA_REGISTRYINDEX, key);
+  lua_pushnil(L);
+  lua_setfield(L, LUA_REGISTRYINDEX, key);
+}
+
+
+static void keepbuffer (lua_State *L, int idx, const char *key) {
+  if (lua_type(L, idx) == LUA_TUSERDATA) {
+    lua_pushvalue(L, idx);
+    lua_setfield(L, LUA_REGISTRYINDEX, key);
+  }
+}
+
+
 static int matchl (lua_State *L) {
-  Capture capture[IMAXCAPTURES];
+  Capture capinit[IMAXCAPTURES];
+  Capture *capture = capinit;
+  int capsize = IMAXCAPTURES;
   const char *r;
   size_t l;
+  int n;
   Instruction *p = getpatt(L, 1, NULL);
   const char *s = luaL_checklstring(L, SUBJIDX, &l);
   lua_Integer i = luaL_optinteger(L, 3, 1);
@@ -1932,18 +2207,345 @@ static int matchl (lua_State *L) {
         ((i <= (lua_Integer)l) ? i - 1 : (lua_Integer)l) :
         (((lua_Integer)l + i >= 0) ? (lua_Integer)l + i : 0);
   lua_settop(L, CAPLISTIDX - 1);
-  lua_pushlightuserdata(L, capture);
+  takebuffer(L, CAPLISTKEY);
+  if (lua_type(L, CAPLISTIDX) == LUA_TUSERDATA &&
+      lua_objlen(L, CAPLISTIDX) > IMAXCAPTURES * sizeof(Capture)) {
+    capture = (Capture *)lua_touserdata(L, CAPLISTIDX);
+    capsize = lua_objlen(L, CAPLISTIDX) / sizeof(Capture);
+  }
+  else {
+    lua_pop(L, 1);
+    lua_pushlightuserdata(L, capture);
+  }
   lua_getfenv(L, 1);
-  r = match(L, s, s + i, s + l, p, capture);
+  takebuffer(L, STACKKEY);
+  r = match(L, s, s + i, s + l, p, capture, capsize, NULL);
+  keepbuffer(L, STACKIDX, STACKKEY);
   if (r == NULL) {
+    keepbuffer(L, CAPLISTIDX, CAPLISTKEY);
     lua_pushnil(L);
     return 1;
   }
-  assert(lua_gettop(L) == PENVIDX);
-  return getcaptures(L, s, r);
+  assert(lua_gettop(L) == STACKIDX);
+  n = getcaptures(L, s, r);
+  keepbuffer(L, CAPLISTIDX, CAPLISTKEY);
+  return n;
+}
+
+
+static int setmaxstack_l (lua_State *L) {
+  int max = luaL_checkint(L, 1);
+  luaL_argcheck(L, max >= INITBACK, 1, "stack size too small");
+  lua_settop(L, 1);
+  lua_setfield(L, LUA_REGISTRYINDEX, MAXSTACKKEY);
+  return 0;
+}
+
+
+/*
+** {======================================================
+** Streams
+** =======================================================
+*/
+
+
+/* slots in the environment of a stream */
+#define SPATTERN	1
+#define SCALLBACK	2
+#define SBUFFER		3
+#define SCAPLIST	4
+#define SSTACK		5
+#define SVALUES		6  /* captured values, when there is no callback */
+
+/* initial size for a stream's input buffer */
+#define SBUFFERSIZE	1024
+
+/* largest look-back of a IFullCapture (see 'getoff') */
+#define MAXLOOKBACK	0xF
+
+#define STREAMTYPE	"lpeg-stream"
+
+#define checkstream(L, idx)	((Stream *)luaL_checkudata(L, idx, STREAMTYPE))
+
+
+typedef struct Stream {
+  Resume rs;
+  size_t len;  /* input in the buffer */
+  size_t pos;  /* current position in the buffer */
+  size_t discarded;  /* input dropped from the front of the buffer */
+  int status;  /* 0: running; 1: matched; -1: failed */
+  int busy;  /* running the match or a callback */
+} Stream;
+
+
+static int stream_l (lua_State *L) {
+  Stream *st;
+  getpatt(L, 1, NULL);
+  if (!lua_isnoneornil(L, 2))
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+  lua_settop(L, 2);
+  st = (Stream *)lua_newuserdata(L, sizeof(Stream));
+  memset(st, 0, sizeof(Stream));
+  luaL_getmetatable(L, STREAMTYPE);
+  lua_setmetatable(L, -2);
+  lua_createtable(L, SVALUES, 0);
+  lua_pushvalue(L, 1);
+  lua_rawseti(L, -2, SPATTERN);
+  lua_pushvalue(L, 2);
+  lua_rawseti(L, -2, SCALLBACK);
+  *(char *)lua_newuserdata(L, SBUFFERSIZE) = '\0';
+  lua_rawseti(L, -2, SBUFFER);
+  lua_newuserdata(L, IMAXCAPTURES * sizeof(Capture));
+  lua_rawseti(L, -2, SCAPLIST);
+  lua_newuserdata(L, INITBACK * sizeof(Stack));
+  lua_rawseti(L, -2, SSTACK);
+  if (lua_isnil(L, 2)) {
+    lua_newtable(L);
+    lua_rawseti(L, -2, SVALUES);
+  }
+  lua_setfenv(L, -2);
+  return 1;
+}
+
+
+/*
+** Appends a chunk to the input buffer, first dropping the input that the
+** match can no longer reach (behind its position, its pending choices
+** and its captures, allowing for the look-back of full captures).
+*/
+static void appendinput (lua_State *L, Stream *st, const char *chunk,
+                         size_t l) {
+  char *buff, *newbuff;
+  Stack *stack;
+  Capture *capture;
+  size_t size, keep = st->pos;
+  int i;
+  lua_getfenv(L, 1);
+  lua_rawgeti(L, -1, SBUFFER);
+  buff = (char *)lua_touserdata(L, -1);
+  size = lua_objlen(L, -1);
+  lua_rawgeti(L, -2, SSTACK);
+  stack = (Stack *)lua_touserdata(L, -1);
+  lua_rawgeti(L, -3, SCAPLIST);
+  capture = (Capture *)lua_touserdata(L, -1);
+  if (st->rs.p != NULL) {  /* match already started? */
+    for (i = 1; i < st->rs.stacktop; i++) {
+      if (stack[i].s != NULL && (size_t)(stack[i].s - buff) < keep)
+        keep = stack[i].s - buff;
+    }
+    /* a pending IFullCapture may start up to MAXLOOKBACK chars behind */
+    keep = (keep > MAXLOOKBACK) ? keep - MAXLOOKBACK : 0;
+    for (i = 0; i < st->rs.captop; i++) {
+      if ((size_t)(capture[i].s - buff) < keep)
+        keep = capture[i].s - buff;
+    }
+  }
+  if (l >= (size_t)-1 - (st->len - keep) - 1)
+    luaL_error(L, "stream input too large");
+  newbuff = buff;
+  if (st->len - keep + l + 1 > size) {
+    size_t newsize = st->len - keep + l + 1;
+    if (newsize < 2 * size) newsize = 2 * size;
+    newbuff = (char *)lua_newuserdata(L, newsize);
+    memcpy(newbuff, buff + keep, st->len - keep);
+    lua_rawseti(L, -5, SBUFFER);
+  }
+  else
+    memmove(newbuff, buff + keep, st->len - keep);
+  memcpy(newbuff + st->len - keep, chunk, l);
+  if (st->rs.p != NULL) {  /* move pointers to the new buffer */
+    stack[0].s = newbuff;  /* 'giveup' does not use its position */
+    for (i = 1; i < st->rs.stacktop; i++) {
+      if (stack[i].s != NULL)
+        stack[i].s = newbuff + (stack[i].s - buff - keep);
+    }
+    for (i = 0; i < st->rs.captop; i++)
+      capture[i].s = newbuff + (capture[i].s - buff - keep);
+  }
+  st->len = st->len - keep + l;
+  newbuff[st->len] = '\0';  /* sentinel, as in Lua strings */
+  st->pos -= keep;
+  st->discarded += keep;
+  lua_pop(L, 4);
+}
+
+
+/*
+** Passes to the callback (or stores) the values of the captures that
+** backtracking can no longer undo, and removes them from the list.
+*/
+static void emitcaptures (lua_State *L, Stream *st, const char *buff) {
+  Capture *capture = (Capture *)lua_touserdata(L, CAPLISTIDX);
+  Stack *stack = (Stack *)lua_touserdata(L, STACKIDX);
+  int limit = st->rs.captop;
+  int depth = 0, k = 0, i;
+  CapState cs;
+  if (st->rs.suspended) {
+    for (i = 1; i < st->rs.stacktop; i++) {
+      if (stack[i].s != NULL && stack[i].caplevel < limit)
+        limit = stack[i].caplevel;
+    }
+  }
+  for (i = 0; i < limit; i++) {  /* find complete top-level captures */
+    if (isclosecap(&capture[i])) depth--;
+    else if (!isfullcap(&capture[i])) depth++;
+    if (depth == 0) k = i + 1;
+  }
+  cs.cap = capture; cs.L = L; cs.s = buff; cs.offset = st->discarded;
+  cs.valuecached = 0;
+  while (cs.cap < capture + k) {
+    int n;
+    lua_rawgeti(L, SUBJIDX, SCALLBACK);
+    if (!lua_isnil(L, -1)) {
+      n = pushcapture(&cs);
+      lua_call(L, n, 0);
+    }
+    else {
+      int top;
+      lua_pop(L, 1);
+      lua_rawgeti(L, SUBJIDX, SVALUES);
+      top = lua_objlen(L, -1);
+      n = pushcapture(&cs);
+      for (i = n; i > 0; i--)
+        lua_rawseti(L, -(i + 1), top + i);
+      lua_pop(L, 1);
+    }
+  }
+  if (k > 0) {
+    memmove(capture, capture + k, (st->rs.captop - k) * sizeof(Capture));
+    st->rs.captop -= k;
+    for (i = 1; i < st->rs.stacktop; i++) {
+      if (stack[i].s != NULL)
+        stack[i].caplevel -= k;
+    }
+  }
+}
+
+
+/* resumes the match over the buffered input; returns the stream results */
+static int runstream (lua_State *L, Stream *st) {
+  const char *buff, *r;
+  Capture *capture;
+  lua_settop(L, 1);
+  lua_getfenv(L, 1);  /* SUBJIDX: stream environment */
+  lua_pushnil(L);  /* SUBSCACHE */
+  lua_rawgeti(L, SUBJIDX, SCAPLIST);
+  lua_rawgeti(L, SUBJIDX, SPATTERN);
+  lua_getfenv(L, -1);  /* PENVIDX */
+  lua_remove(L, -2);
+  lua_rawgeti(L, SUBJIDX, SSTACK);
+  lua_rawgeti(L, SUBJIDX, SBUFFER);
+  buff = (const char *)lua_touserdata(L, -1);
+  lua_pop(L, 1);
+  lua_rawgeti(L, SUBJIDX, SPATTERN);
+  capture = (Capture *)lua_touserdata(L, CAPLISTIDX);
+  st->busy = 1;
+  r = match(L, buff, buff + st->pos, buff + st->len,
+            (Instruction *)lua_touserdata(L, -1), capture,
+            lua_objlen(L, CAPLISTIDX) / sizeof(Capture), &st->rs);
+  lua_pop(L, 1);
+  assert(lua_gettop(L) == STACKIDX);
+  /* stack and capture list may have been reallocated */
+  lua_pushvalue(L, CAPLISTIDX);
+  lua_rawseti(L, SUBJIDX, SCAPLIST);
+  lua_pushvalue(L, STACKIDX);
+  lua_rawseti(L, SUBJIDX, SSTACK);
+  if (r == NULL) {
+    st->status = -1;
+    st->busy = 0;
+    lua_pushboolean(L, 0);
+    return 1;
+  }
+  st->pos = r - buff;
+  if (!st->rs.suspended) {  /* reached the end of the pattern */
+    Capture *cap = (Capture *)lua_touserdata(L, CAPLISTIDX);
+    int depth = 0, i;
+    for (i = 0; depth > 0 || !isclosecap(&cap[i]); i++) {  /* find end mark */
+      if (isclosecap(&cap[i])) depth--;
+      else if (!isfullcap(&cap[i])) depth++;
+    }
+    st->rs.captop = i;
+    st->status = 1;
+  }
+  emitcaptures(L, st, buff);
+  st->busy = 0;
+  if (st->status == 0)
+    return 0;  /* undecided: needs more input */
+  lua_pushinteger(L, st->discarded + st->pos + 1);
+  lua_rawgeti(L, SUBJIDX, SVALUES);
+  if (lua_isnil(L, -1)) {  /* values went to the callback? */
+    lua_pop(L, 1);
+    return 1;
+  }
+  return 2;
+}
+
+
+static Stream *checkrunning (lua_State *L) {
+  Stream *st = checkstream(L, 1);
+  if (st->busy)
+    luaL_error(L, "stream is busy (or broken by an error)");
+  if (st->status != 0)
+    luaL_error(L, "stream is finished");
+  return st;
 }
 
 
+static int feed_l (lua_State *L) {
+  Stream *st = checkrunning(L);
+  size_t l;
+  const char *chunk = luaL_checklstring(L, 2, &l);
+  appendinput(L, st, chunk, l);
+  return runstream(L, st);
+}
+
+
+static int finish_l (lua_State *L) {
+  Stream *st = checkrunning(L);
+  st->rs.eof = 1;
+  return runstream(L, st);
+}
+
+
+static int streammatch_l (lua_State *L) {
+  luaL_checktype(L, 2, LUA_TFUNCTION);
+  lua_settop(L, 3);
+  lua_pushcfunction(L, stream_l);
+  lua_pushvalue(L, 1);
+  lua_pushvalue(L, 3);
+  lua_call(L, 2, 1);  /* stream at index 4 */
+  for (;;) {
+    size_t l;
+    lua_pushvalue(L, 2);
+    lua_call(L, 0, 1);  /* read next chunk */
+    if (lua_isnil(L, -1) || (lua_tolstring(L, -1, &l) != NULL && l == 0))
+      break;
+    if (!lua_isstring(L, -1))
+      luaL_error(L, "reader function must return a string");
+    lua_pushcfunction(L, feed_l);
+    lua_pushvalue(L, 4);
+    lua_pushvalue(L, -3);
+    lua_call(L, 2, LUA_MULTRET);
+    if (lua_gettop(L) > 5)  /* decided? */
+      return lua_gettop(L) - 5;
+    lua_settop(L, 4);
+  }
+  lua_pushcfunction(L, finish_l);
+  lua_pushvalue(L, 4);
+  lua_call(L, 1, LUA_MULTRET);
+  return lua_gettop(L) - 5;
+}
+
+
+static struct luaL_reg streamreg[] = {
+  {"feed", feed_l},
+  {"finish", finish_l},
+  {NULL, NULL}
+};
+
+/* }====================================================== */
+
+
 static struct luaL_reg pattreg[] = {
   {"match", matchl},
   {"print", printpat_l},
@@ -1958,6 +2560,9 @@ static struct luaL_reg pattreg[] = {
   {"S", set_l},
   {"V", nter_l},
   {"span", span_l},
+  {"setmaxstack", setmaxstack_l},
+  {"stream", stream_l},
+  {"streammatch", streammatch_l},
   {NULL, NULL}
 };
 
@@ -1981,6 +2586,11 @@ int luaopen_lpeg (lua_State *L);
 int luaopen_lpeg (lua_State *L) {
   lua_newtable(L);
   lua_replace(L, LUA_ENVIRONINDEX);  /* empty env for new patterns */
+  luaL_newmetatable(L, STREAMTYPE);
+  lua_pushvalue(L, -1);
+  lua_setfield(L, -2, "__index");
+  luaL_register(L, NULL, streamreg);
+  lua_pop(L, 1);
   luaL_newmetatable(L, "pattern");
   luaL_register(L, NULL, metapattreg);
   luaL_register(L, "lpeg", pattreg);
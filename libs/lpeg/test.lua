@@ -237,6 +237,11 @@ assert(table.concat(t[1], ";") == "1;2;2;3;3;4")
 t = m.match(m.Ct(m.C(m.C(1) * 1 * m.C(1))), "alo")
 checkeq(t, {"alo", "a", "o"})
 
+-- nested captures, captures with several or no values
+t = m.match(m.Ct(m.Cc(1, 2) * m.C(m.C(1) * m.Ct(m.C(1)^0)) * m.Cc() * m.Cp()),
+            "alo")
+checkeq(t, {1, 2, "alo", "a", {"l", "o"}, 4})
+
 
 
 -- test for non-pattern as arguments to pattern functions
@@ -305,6 +310,112 @@ assert(m.match(g, "abbbcx") == 7)
 assert(m.match(g, "abbbbx") == 2)
 
 
+-- tests for deep backtracking (stack grows beyond its initial size)
+g = m.P{ "(" * m.V(1) * ")" + "" }
+assert(m.match(g, string.rep("(", 3000) .. string.rep(")", 3000)) == 6001)
+assert(not pcall(m.match, g, string.rep("(", 20000) .. string.rep(")", 20000)))
+m.setmaxstack(50000)
+assert(m.match(g, string.rep("(", 20000) .. string.rep(")", 20000)) == 40001)
+-- nested matches do not share the stack
+local f = m.P(function (s, i)
+  return m.match(g, string.rep("(", 300) .. string.rep(")", 300)) and i
+end)
+assert(m.match(g * f, string.rep("(", 300) .. string.rep(")", 300)) == 601)
+t = m.match(m.Ct((m.C(1) / function (c) return m.match(g, "(())") and c end)^0),
+            string.rep("x", 500))
+assert(#t == 500 and t[500] == "x")
+
+
+-- tests for searching loops (skip chars that cannot start the pattern)
+do
+  local s = string.rep("abc\0de", 1000) .. "xyz" .. "abc"
+  local function search (p) return (1 - m.P(p))^0 * m.Cp() * p end
+  assert(m.match(search"xyz", s) == 6001)
+  assert(m.match(search"xyz", s .. "xyz") == 6001)
+  assert(m.match(search"\0de", s) == 4)
+  assert(not m.match(search"xyw", s))
+  assert(m.match(search(m.S"zy"), s) == 6002)
+  assert(m.match(search(m.P"xa" + "xy" + m.C"ab" * "d"), s) == 6001)
+  assert(m.match((1 - m.P"c")^0, s) == 3)
+  local t = m.match(m.Ct((m.C"xyz" + m.Cp() * "abc" + 1)^0), s)
+  assert(#t == 1002 and t[1] == 1 and t[1001] == "xyz" and t[1002] == 6004)
+  t = m.match(m.Ct((m.C(m.P"de" + "x" * -m.P"y") + 1)^0 * m.Cp()), s)
+  assert(#t == 1001 and t[1] == "de" and t[1001] == #s + 1)
+  -- optional and repeated parts around the skipped chars
+  assert(m.match((1 - m.P"a")^2 * "a", "xxxa") == 5)
+  assert(not m.match((1 - m.P"a")^2 * "a", "xa"))
+  assert(m.match((m.P"ab" + 1)^0 * -1, "xaxabx") == 7)
+end
+
+
+-- tests for streams
+do
+  local lines = {}
+  local st = m.stream((m.C((1 - m.P"\n")^0) * "\n")^0 * -1,
+                      function (l) lines[#lines + 1] = l end)
+  assert(st:feed("abc\nde") == nil and #lines == 1)
+  assert(st:feed("f\n\nx") == nil and #lines == 3 and lines[2] == "def")
+  assert(st:feed("yz\n") == nil and lines[4] == "xyz")
+  assert(st:finish() == 14)
+  assert(not pcall(st.feed, st, "more"))
+
+  -- same results as 'match' for any chunking
+  local s = string.rep("alo 12; ", 300)
+  local p = (m.C(m.R"az"^1) * " " * (m.R"09"^1 / tonumber) * m.Cp() * "; ")^0
+  local t1 = {m.match(p, s)}
+  for _, n in ipairs{1, 2, 7, 100} do
+    local st = m.stream(p)
+    for i = 1, #s, n do assert(st:feed(s:sub(i, i + n - 1)) == nil) end
+    local e, t2 = st:finish()
+    assert(e == #s + 1 and #t2 == #t1)
+    for i = 1, #t1 do assert(t1[i] == t2[i]) end
+  end
+
+  -- backtracking across chunks
+  st = m.stream(m.P"abcX" + m.P"abcY" + m.C"ab")
+  assert(st:feed("a") == nil and st:feed("bc") == nil)
+  local e, t = st:feed("Y")
+  assert(e == 5 and #t == 0)
+  st = m.stream(m.P"abc" * -1)
+  assert(st:feed("ab") == nil and st:feed("d") == false)
+
+  local i = 0
+  e, t = m.streammatch(m.C(m.P"a"^1), function ()
+    i = i + 1
+    if i <= 10 then return "a" end
+  end)
+  assert(e == 11 and t[1] == string.rep("a", 10))
+  assert(not pcall(m.streammatch, m.P(function () return 1 end),
+                   function () end))
+
+  -- nested, table and substitution captures, also across chunk limits
+  local function checkstream (p, s)
+    local t1 = {m.match(p, s)}
+    for n = 1, #s do
+      local st, e, t2 = m.stream(p)
+      for i = 1, #s, n do
+        assert(e == nil)
+        e, t2 = st:feed(s:sub(i, i + n - 1))
+      end
+      if e == nil then e, t2 = st:finish() end
+      assert(e == #s + 1)
+      checkeq(t2, t1)
+    end
+  end
+  checkstream(m.Ct(m.C(1)^0), "abcdef")
+  checkstream(m.C(m.C(1) * m.C(1)), "ab")
+  checkstream(m.C(m.C(1) * m.C(m.C(1) * m.C(1))) * m.C(1), "abcd")
+  checkstream(m.Cs((m.P"a" / "x" + 1)^0), "banana")
+  checkstream(m.Ct((m.Ct(m.C(m.R"az"^1)) * m.P" "^-1)^0), "alo ola xyz")
+  checkstream(m.C(m.P"xyzw"), "xyzw")
+  checkstream(m.C(m.P"abcdefghijklmnop") * m.C(m.P"q"), "abcdefghijklmnopq")
+  st = m.stream(m.C(m.P"xyzw"))
+  assert(st:feed("xy") == nil)
+  e, t = st:feed("zw")
+  assert(e == 5 and t[1] == "xyzw")
+end
+
+
 -- tests for \0
 assert(m.match(m.R("\0\1")^1, "\0\1\0") == 4)
 assert(m.match(m.S("\0\1ab")^1, "\0\1\0a") == 5)
@@ -24,6 +24,23 @@ static int generate_error  (lua_State *L, const TUserdata *ud, int errcode);
 #define DO_NAMED_SUBPATTERNS(a,b,c)
 #endif
 
+/* Appends the locale part of a regex cache key.
+ * The default suits bindings where the locale is a name string.
+ */
+#ifndef ALG_ADDLOCALEKEY
+#  define ALG_ADDLOCALEKEY(B,argC) \
+  if ((argC)->locale) { \
+    luaL_addstring (B, (argC)->locale); \
+    luaL_addchar (B, '\0'); \
+  } \
+  else luaL_addchar (B, '-')
+#endif
+
+/* Default maximal number of regexes kept by the function forms */
+#ifndef ALG_CACHESIZE
+#  define ALG_CACHESIZE 32
+#endif
+
 /*  When doing an iterative search, there can occur a situation of a zero-length
  *  match at the current position, that prevents further advance on the subject
  *  string.
@@ -108,6 +125,9 @@ static void check_pattern (lua_State *L, int pos, TArgComp *argC)
   if (lua_isstring (L, pos)) {
     argC->pattern = lua_tolstring (L, pos, &argC->patlen);
     argC->ud = NULL;
+    argC->locale = NULL;    /* these take part in the cache key */
+    argC->tables = NULL;
+    argC->syntax = NULL;
   }
   else if ((argC->ud = test_ud (L, pos)) == NULL)
     luaL_typerror(L, pos, "string or "REX_TYPENAME);
@@ -178,6 +198,142 @@ static void checkarg_find_method (lua_State *L, TArgExec *argE, TUserdata **ud)
 }
 
 
+/*  Regex cache of the function forms (find, match, gmatch, gsub, split).
+ *  A pattern given as a string is compiled once and reused by later calls
+ *  with the same pattern, cf and lo (locale, chartables or syntax). When the
+ *  cache is full, the least recently used regex is dropped from it.
+ *  The cache lives in the function environment:
+ *    [INDEX_CACHE_INFO]   - TCacheInfo userdata
+ *    [INDEX_CACHE_REGEX]  - key -> regex userdata
+ *    [INDEX_CACHE_STAMPS] - key -> time of last use
+ */
+#define INDEX_CACHE_INFO   10
+#define INDEX_CACHE_REGEX  11
+#define INDEX_CACHE_STAMPS 12
+
+typedef struct {
+  int        size;    /* max. number of entries; 0 disables the cache */
+  int        count;
+  lua_Number clock;
+} TCacheInfo;
+
+static TCacheInfo* cache_info (lua_State *L) {
+  TCacheInfo *ci;
+  lua_rawgeti (L, LUA_ENVIRONINDEX, INDEX_CACHE_INFO);
+  ci = (TCacheInfo*) lua_touserdata (L, -1);
+  lua_pop (L, 1);         /* still referenced by the environment */
+  return ci;
+}
+
+static void cache_clear (lua_State *L) {
+  TCacheInfo *ci = cache_info (L);
+  ci->count = 0;
+  lua_createtable (L, 0, ci->size);       /* presized: the cache fills up */
+  lua_rawseti (L, LUA_ENVIRONINDEX, INDEX_CACHE_REGEX);
+  lua_createtable (L, 0, ci->size);
+  lua_rawseti (L, LUA_ENVIRONINDEX, INDEX_CACHE_STAMPS);
+}
+
+static void cache_init (lua_State *L) {
+  TCacheInfo *ci = (TCacheInfo*) lua_newuserdata (L, sizeof (TCacheInfo));
+  ci->size = ALG_CACHESIZE;
+  ci->count = 0;
+  ci->clock = 0;
+  lua_rawseti (L, LUA_ENVIRONINDEX, INDEX_CACHE_INFO);
+  cache_clear (L);
+}
+
+static void push_cache_key (lua_State *L, const TArgComp *argC) {
+  luaL_Buffer B;
+  luaL_buffinit (L, &B);
+  luaL_addlstring (&B, (const char*)&argC->cflags, sizeof (argC->cflags));
+  luaL_addlstring (&B, (const char*)&argC->tables, sizeof (argC->tables));
+  luaL_addlstring (&B, (const char*)&argC->syntax, sizeof (argC->syntax));
+  ALG_ADDLOCALEKEY (&B, argC);
+  luaL_addlstring (&B, argC->pattern, argC->patlen);
+  luaL_pushresult (&B);
+}
+
+/* drop the least recently used entry */
+static void cache_evict (lua_State *L, TCacheInfo *ci) {
+  lua_Number oldest = 0;
+  int stamps;
+  lua_rawgeti (L, LUA_ENVIRONINDEX, INDEX_CACHE_STAMPS);
+  stamps = lua_gettop (L);
+  lua_pushnil (L);                          /* key of the oldest entry */
+  lua_pushnil (L);
+  while (lua_next (L, stamps)) {
+    lua_Number stamp = lua_tonumber (L, -1);
+    lua_pop (L, 1);
+    if (lua_isnil (L, stamps + 1) || stamp < oldest) {
+      oldest = stamp;
+      lua_pushvalue (L, -1);
+      lua_replace (L, stamps + 1);
+    }
+  }
+  if (!lua_isnil (L, stamps + 1)) {
+    lua_pushvalue (L, stamps + 1);
+    lua_pushnil (L);
+    lua_rawset (L, stamps);
+    lua_rawgeti (L, LUA_ENVIRONINDEX, INDEX_CACHE_REGEX);
+    lua_pushvalue (L, stamps + 1);
+    lua_pushnil (L);
+    lua_rawset (L, -3);
+    --ci->count;
+  }
+  lua_settop (L, stamps - 1);
+}
+
+/* same as compile_regex, but takes the regex from the cache if possible */
+static void compile_regex_cached (lua_State *L, const TArgComp *argC,
+                                  TUserdata **pud) {
+  TCacheInfo *ci = cache_info (L);
+  if (ci->size <= 0) {
+    compile_regex (L, argC, pud);
+    return;
+  }
+  push_cache_key (L, argC);                               /* key */
+  lua_rawgeti (L, LUA_ENVIRONINDEX, INDEX_CACHE_REGEX);   /* key regexes */
+  lua_pushvalue (L, -2);
+  lua_rawget (L, -2);                                     /* key regexes ud */
+  if (lua_isnil (L, -1)) {
+    lua_pop (L, 1);
+    compile_regex (L, argC, pud);
+    if (ci->count >= ci->size)
+      cache_evict (L, ci);
+    lua_pushvalue (L, -3);
+    lua_pushvalue (L, -2);
+    lua_rawset (L, -4);
+    ++ci->count;
+  }
+  else
+    *pud = (TUserdata*) lua_touserdata (L, -1);
+  lua_rawgeti (L, LUA_ENVIRONINDEX, INDEX_CACHE_STAMPS);
+  lua_pushvalue (L, -4);
+  ci->clock += 1;
+  lua_pushnumber (L, ci->clock);
+  lua_rawset (L, -3);
+  lua_pop (L, 1);
+  lua_replace (L, -3);                                    /* ud regexes */
+  lua_pop (L, 1);                                         /* ud */
+}
+
+/* function setcachesize (n): returns the previous size */
+static int cache_setsize (lua_State *L) {
+  TCacheInfo *ci = cache_info (L);
+  int size = luaL_checkint (L, 1);
+  if (size < 0)
+    luaL_argerror (L, 1, "negative cache size");
+  lua_pushinteger (L, ci->size);
+  ci->size = size;
+  if (ci->size == 0)
+    cache_clear (L);
+  while (ci->count > ci->size)
+    cache_evict (L, ci);
+  return 1;
+}
+
+
 static int ud_new (lua_State *L) {
   TArgComp argC;
   checkarg_new (L, &argC);
@@ -210,7 +366,7 @@ static int gsub (lua_State *L) {
     ud = (TUserdata*) argC.ud;
     lua_pushvalue (L, 2);
   }
-  else compile_regex (L, &argC, &ud);
+  else compile_regex_cached (L, &argC, &ud);
   freelist_init (&freelist);
   /*------------------------------------------------------------------*/
   if (argE.reptype == LUA_TSTRING) {
@@ -412,7 +568,7 @@ static int generic_find_func (lua_State *L, int method) {
     ud = (TUserdata*) argC.ud;
     lua_pushvalue (L, 2);
   }
-  else compile_regex (L, &argC, &ud);
+  else compile_regex_cached (L, &argC, &ud);
   res = findmatch_exec (ud, &argE);
   return finish_generic_find (L, ud, &argE, method, res);
 }
@@ -543,7 +699,7 @@ static int gmatch (lua_State *L)
     ud = (TUserdata*) argC.ud;
     lua_pushvalue (L, 2);
   }
-  else compile_regex (L, &argC, &ud);         /* 1-st upvalue: ud */
+  else compile_regex_cached (L, &argC, &ud);  /* 1-st upvalue: ud */
   gmatch_pushsubject (L, &argE);              /* 2-nd upvalue: s  */
   lua_pushinteger (L, argE.eflags);           /* 3-rd upvalue: ef */
   lua_pushinteger (L, 0);                     /* 4-th upvalue: startoffset */
@@ -566,7 +722,7 @@ static int split (lua_State *L)
     ud = (TUserdata*) argC.ud;
     lua_pushvalue (L, 2);
   }
-  else compile_regex (L, &argC, &ud);         /* 1-st upvalue: ud */
+  else compile_regex_cached (L, &argC, &ud);  /* 1-st upvalue: ud */
   gmatch_pushsubject (L, &argE);              /* 2-nd upvalue: s  */
   lua_pushinteger (L, argE.eflags);           /* 3-rd upvalue: ef */
   lua_pushinteger (L, 0);                     /* 4-th upvalue: startoffset */
@@ -578,7 +734,7 @@ static int split (lua_State *L)
 
 static void push_substring_table (lua_State *L, TUserdata *ud, const char *text) {
   int i;
-  lua_newtable (L);
+  lua_createtable (L, ALG_NSUB(ud), 0);
   for (i = 1; i <= ALG_NSUB(ud); i++) {
     ALG_PUSHSUB_OR_FALSE (L, ud, text, i);
     lua_rawseti (L, -2, i);
@@ -588,7 +744,7 @@ static void push_substring_table (lua_State *L, TUserdata *ud, const char *text)
 
 static void push_offset_table (lua_State *L, TUserdata *ud, int startoffset) {
   int i, j;
-  lua_newtable (L);
+  lua_createtable (L, 2 * ALG_NSUB(ud), 0);
   for (i=1, j=1; i <= ALG_NSUB(ud); i++) {
     if (ALG_SUBVALID (ud,i)) {
       ALG_PUSHSTART (L, ud, startoffset, i);
@@ -41,8 +41,13 @@ int get_flags (lua_State *L, const flag_pair **arrs) {
   const flag_pair **pp;
   int nparams = lua_gettop(L);
 
-  if(nparams == 0)
-    lua_newtable(L);
+  if(nparams == 0) {
+    int nkeys = 0;
+    for(pp=arrs; *pp; ++pp)
+      for(p=*pp; p->key; ++p)
+        ++nkeys;
+    lua_createtable(L, 0, nkeys);
+  }
   else {
     if(!lua_istable(L, 1))
       luaL_argerror(L, 1, "not a table");
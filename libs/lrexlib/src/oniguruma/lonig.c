@@ -37,6 +37,10 @@ static void optlocale (TArgComp *argC, lua_State *L, int pos);
 static void optsyntax (TArgComp *argC, lua_State *L, int pos);
 #define ALG_OPTSYNTAX(a,b,c)  optsyntax(a,b,c)
 
+/* the "locale" is an OnigEncoding pointer rather than a name */
+#define ALG_ADDLOCALEKEY(B,argC) \
+  luaL_addlstring (B, (const char*)&(argC)->locale, sizeof ((argC)->locale))
+
 #define ALG_NOMATCH        ONIG_MISMATCH
 #define ALG_ISMATCH(res)   ((res) >= 0)
 #define ALG_SUBBEG(ud,n)   ud->region->beg[n]
@@ -334,6 +338,7 @@ static const luaL_reg rexlib[] = {
   { "split",            split },
   { "new",              ud_new },
   { "plainfind",        plainfind_func },
+  { "setcachesize",     cache_setsize },
   { "flags",            LOnig_get_flags },
   { "version",          LOnig_version },
   { "setdefaultsyntax", LOnig_setdefaultsyntax },
@@ -357,6 +362,7 @@ REX_API int REX_OPENLIB (lua_State *L) {
   lua_pushvalue(L, -1); /* mt.__index = mt */
   lua_setfield(L, -2, "__index");
   luaL_register (L, NULL, regex_meta);
+  cache_init (L);
 
   /* register functions */
   luaL_register (L, REX_LIBNAME, rexlib);
@@ -30,6 +30,24 @@ extern flag_pair pcre_error_flags[];
 #define ALG_CFLAGS_DFLT 0
 #define ALG_EFLAGS_DFLT 0
 
+#define VERSION_PCRE (PCRE_MAJOR*100 + PCRE_MINOR)
+
+/* JIT compilation appeared in PCRE 8.20, the fast JIT entry in 8.32 */
+#if VERSION_PCRE >= 820
+#  define LPCRE_JIT
+#endif
+#if VERSION_PCRE >= 832
+#  define LPCRE_JIT_EXEC
+#endif
+
+/* Size limits of the JIT stack shared by regexes of a library instance */
+#ifndef LPCRE_JITSTACK_START
+#  define LPCRE_JITSTACK_START (32 * 1024)
+#endif
+#ifndef LPCRE_JITSTACK_MAX
+#  define LPCRE_JITSTACK_MAX (1024 * 1024)
+#endif
+
 static int getcflags (lua_State *L, int pos);
 #define ALG_GETCFLAGS(L,pos)  getcflags(L, pos)
 
@@ -65,6 +83,9 @@ typedef struct {
   int        * match;
   int          ncapt;
   const unsigned char * tables;
+#ifdef LPCRE_JIT
+  pcre_jit_stack * jitstack;    /* non-NULL: JIT code can run on it directly */
+#endif
   int          freed;
 } TPcre;
 
@@ -77,9 +98,11 @@ static void do_named_subpatterns (lua_State *L, TPcre *ud, const char *text);
 
 #include "../algo.h"
 
-/* Locations of the 2 permanent tables in the function environment */
+/* Locations of the permanent values in the function environment */
 #define INDEX_CHARTABLES_META  1      /* chartables type's metatable */
 #define INDEX_CHARTABLES_LINK  2      /* link chartables to compiled regex */
+#define INDEX_JIT_ENABLED      3      /* boolean: study new regexes with JIT */
+#define INDEX_JIT_STACK        4      /* JIT stack userdata, created on demand */
 
 const char chartables_typename[] = "chartables";
 
@@ -182,11 +205,46 @@ static void optlocale (TArgComp *argC, lua_State *L, int pos) {
   }
 }
 
+#ifdef LPCRE_JIT
+static int jitstack_gc (lua_State *L) {
+  pcre_jit_stack **q = (pcre_jit_stack **)lua_touserdata (L, 1);
+  if (*q) {
+    pcre_jit_stack_free (*q);
+    *q = NULL;
+  }
+  return 0;
+}
+
+static pcre_jit_stack *get_jitstack (lua_State *L) {
+  pcre_jit_stack **q;
+  lua_rawgeti (L, LUA_ENVIRONINDEX, INDEX_JIT_STACK);
+  q = (pcre_jit_stack **)lua_touserdata (L, -1);
+  lua_pop (L, 1);
+  if (q == NULL) {
+    q = (pcre_jit_stack **)lua_newuserdata (L, sizeof (pcre_jit_stack *));
+    *q = NULL;
+    lua_createtable (L, 0, 1);
+    lua_pushcfunction (L, jitstack_gc);
+    lua_setfield (L, -2, "__gc");
+    lua_setmetatable (L, -2);
+    lua_rawseti (L, LUA_ENVIRONINDEX, INDEX_JIT_STACK);
+    *q = pcre_jit_stack_alloc (LPCRE_JITSTACK_START, LPCRE_JITSTACK_MAX);
+  }
+  return *q;
+}
+
+static int jit_available (void) {
+  int val = 0;
+  return pcre_config (PCRE_CONFIG_JIT, &val) == 0 && val;
+}
+#endif
+
 static int compile_regex (lua_State *L, const TArgComp *argC, TPcre **pud) {
   const char *error;
   int erroffset;
   TPcre *ud;
   const unsigned char *tables = NULL;
+  int study_options = 0;
 
   ud = (TPcre*)lua_newuserdata (L, sizeof (TPcre));
   memset (ud, 0, sizeof (TPcre));           /* initialize all members to 0 */
@@ -215,9 +273,31 @@ static int compile_regex (lua_State *L, const TArgComp *argC, TPcre **pud) {
   if (!ud->pr)
     return luaL_error (L, "%s (pattern offset: %d)", error, erroffset + 1);
 
-  ud->extra = pcre_study (ud->pr, 0, &error);
+#ifdef LPCRE_JIT
+  lua_rawgeti (L, LUA_ENVIRONINDEX, INDEX_JIT_ENABLED);
+  if (lua_toboolean (L, -1))
+    study_options |= PCRE_STUDY_JIT_COMPILE;
+  lua_pop (L, 1);
+#endif
+
+  ud->extra = pcre_study (ud->pr, study_options, &error);
   if (error) return luaL_error (L, "%s", error);
 
+#ifdef LPCRE_JIT
+  if (study_options & PCRE_STUDY_JIT_COMPILE) {
+    int jit = 0;
+    pcre_fullinfo (ud->pr, ud->extra, PCRE_INFO_JIT, &jit);
+    if (jit) {    /* else the pattern is not supported by JIT, keep interpreting */
+      pcre_jit_stack *stack = get_jitstack (L);
+      unsigned long options = 0;
+      pcre_assign_jit_stack (ud->extra, NULL, stack);
+      pcre_fullinfo (ud->pr, ud->extra, PCRE_INFO_OPTIONS, &options);
+      if (!(options & PCRE_UTF8))     /* pcre_jit_exec skips the UTF-8 check */
+        ud->jitstack = stack;
+    }
+  }
+#endif
+
   pcre_fullinfo (ud->pr, ud->extra, PCRE_INFO_CAPTURECOUNT, &ud->ncapt);
   /* need (2 ints per capture, plus one for substring match) * 3/2 */
   ud->match = (int *) Lmalloc (L, (ALG_NSUB(ud) + 1) * 3 * sizeof (int));
@@ -271,7 +351,7 @@ static int Lpcre_dfa_exec (lua_State *L)
     int i;
     int max = (res>0) ? res : (res==0) ? (int)argE.ovecsize/2 : 1;
     lua_pushinteger (L, ovector[0] + 1);         /* 1-st return value */
-    lua_newtable (L);                            /* 2-nd return value */
+    lua_createtable (L, max, 0);                 /* 2-nd return value */
     for (i=0; i<max; i++) {
       lua_pushinteger (L, ovector[i+i+1]);
       lua_rawseti (L, -2, i+1);
@@ -290,16 +370,31 @@ static int Lpcre_dfa_exec (lua_State *L)
 }
 #endif /* #if PCRE_MAJOR >= 6 */
 
+/* exec options that JIT code handles by itself */
+#ifdef LPCRE_JIT_EXEC
+#  define JIT_EFLAGS (PCRE_NOTBOL|PCRE_NOTEOL|PCRE_NOTEMPTY|PCRE_NOTEMPTY_ATSTART|\
+                      PCRE_NO_UTF8_CHECK)
+#endif
+
+/* Match in a loop (gmatch, gsub, split): run JIT code directly when possible */
+static int loop_exec (TPcre *ud, TArgExec *argE, int st, int eflags) {
+#ifdef LPCRE_JIT_EXEC
+  if (ud->jitstack && (eflags & ~JIT_EFLAGS) == 0)
+    return pcre_jit_exec (ud->pr, ud->extra, argE->text, argE->textlen,
+      st, eflags, ud->match, (ALG_NSUB(ud) + 1) * 3, ud->jitstack);
+#endif
+  return pcre_exec (ud->pr, ud->extra, argE->text, argE->textlen,
+    st, eflags, ud->match, (ALG_NSUB(ud) + 1) * 3);
+}
+
 #ifdef ALG_USERETRY
   static int gmatch_exec (TUserdata *ud, TArgExec *argE, int retry) {
     int eflags = retry ? (argE->eflags|PCRE_NOTEMPTY|PCRE_ANCHORED) : argE->eflags;
-    return pcre_exec (ud->pr, ud->extra, argE->text, argE->textlen,
-      argE->startoffset, eflags, ud->match, (ALG_NSUB(ud) + 1) * 3);
+    return loop_exec (ud, argE, argE->startoffset, eflags);
   }
 #else
   static int gmatch_exec (TUserdata *ud, TArgExec *argE) {
-    return pcre_exec (ud->pr, ud->extra, argE->text, argE->textlen,
-      argE->startoffset, argE->eflags, ud->match, (ALG_NSUB(ud) + 1) * 3);
+    return loop_exec (ud, argE, argE->startoffset, argE->eflags);
   }
 #endif
 
@@ -315,19 +410,16 @@ static int findmatch_exec (TPcre *ud, TArgExec *argE) {
 #ifdef ALG_USERETRY
   static int gsub_exec (TPcre *ud, TArgExec *argE, int st, int retry) {
     int eflags = retry ? (argE->eflags|PCRE_NOTEMPTY|PCRE_ANCHORED) : argE->eflags;
-    return pcre_exec (ud->pr, ud->extra, argE->text, argE->textlen,
-      st, eflags, ud->match, (ALG_NSUB(ud) + 1) * 3);
+    return loop_exec (ud, argE, st, eflags);
   }
 #else
   static int gsub_exec (TPcre *ud, TArgExec *argE, int st) {
-    return pcre_exec (ud->pr, ud->extra, argE->text, argE->textlen,
-      st, argE->eflags, ud->match, (ALG_NSUB(ud) + 1) * 3);
+    return loop_exec (ud, argE, st, argE->eflags);
   }
 #endif
 
 static int split_exec (TPcre *ud, TArgExec *argE, int offset) {
-  return pcre_exec (ud->pr, ud->extra, argE->text, argE->textlen, offset,
-                    argE->eflags, ud->match, (ALG_NSUB(ud) + 1) * 3);
+  return loop_exec (ud, argE, offset, argE->eflags);
 }
 
 static int Lpcre_gc (lua_State *L) {
@@ -335,13 +427,67 @@ static int Lpcre_gc (lua_State *L) {
   if (ud->freed == 0) {           /* precaution against "manual" __gc calling */
     ud->freed = 1;
     if (ud->pr)      pcre_free (ud->pr);
+#ifdef LPCRE_JIT
+    if (ud->extra)   pcre_free_study (ud->extra);
+#else
     if (ud->extra)   pcre_free (ud->extra);
+#endif
     if (ud->tables)  pcre_free ((void *)ud->tables);
     if (ud->match)   free (ud->match);
   }
   return 0;
 }
 
+/* method r:setmatchlimit (limit, [limit_recursion]) */
+static int Lpcre_setmatchlimit (lua_State *L) {
+  TPcre *ud = check_ud (L);
+  long limit = luaL_checklong (L, 2);
+#ifdef PCRE_EXTRA_MATCH_LIMIT_RECURSION
+  long limit_recursion = luaL_optlong (L, 3, 0);
+  if (limit_recursion < 0)
+    luaL_argerror (L, 3, "negative limit");
+#endif
+  if (limit < 0)
+    luaL_argerror (L, 2, "negative limit");
+  if (ud->extra == NULL) {        /* pcre_study found nothing to record */
+    ud->extra = (pcre_extra *) pcre_malloc (sizeof (pcre_extra));
+    if (ud->extra == NULL)
+      return luaL_error (L, "malloc failed");
+    memset (ud->extra, 0, sizeof (pcre_extra));
+  }
+  if (limit > 0) {
+    ud->extra->flags |= PCRE_EXTRA_MATCH_LIMIT;
+    ud->extra->match_limit = (unsigned long)limit;
+  }
+  else
+    ud->extra->flags &= ~PCRE_EXTRA_MATCH_LIMIT;
+#ifdef PCRE_EXTRA_MATCH_LIMIT_RECURSION
+  if (limit_recursion > 0) {
+    ud->extra->flags |= PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+    ud->extra->match_limit_recursion = (unsigned long)limit_recursion;
+  }
+  else
+    ud->extra->flags &= ~PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+#endif
+  lua_settop (L, 1);
+  return 1;
+}
+
+/* function setjit (on): returns true if JIT is used for new regexes */
+static int Lpcre_setjit (lua_State *L) {
+  int on = lua_toboolean (L, 1);
+#ifdef LPCRE_JIT
+  on = on && jit_available ();
+#else
+  on = 0;
+#endif
+  lua_pushboolean (L, on);
+  lua_rawseti (L, LUA_ENVIRONINDEX, INDEX_JIT_ENABLED);
+  cache_clear (L);                /* cached regexes were studied the old way */
+  lua_pushboolean (L, on);
+  return 1;
+}
+
 static int Lpcre_tostring (lua_State *L) {
   TPcre *ud = check_ud (L);
   if (ud->freed == 0)
@@ -376,6 +522,7 @@ static const luaL_reg regex_meta[] = {
 #if PCRE_MAJOR >= 6
   { "dfa_exec",    Lpcre_dfa_exec },
 #endif
+  { "setmatchlimit", Lpcre_setmatchlimit },
   { "__gc",        Lpcre_gc },
   { "__tostring",  Lpcre_tostring },
   { NULL, NULL }
@@ -389,9 +536,11 @@ static const luaL_reg rexlib[] = {
   { "split",       split },
   { "new",         ud_new },
   { "plainfind",   plainfind_func },
+  { "setcachesize", cache_setsize },
   { "flags",       Lpcre_get_flags },
   { "version",     Lpcre_version },
   { "maketables",  Lpcre_maketables },
+  { "setjit",      Lpcre_setjit },
 #if PCRE_MAJOR >= 4
   { "config",      Lpcre_config },
 #endif
@@ -416,6 +565,7 @@ REX_API int REX_OPENLIB (lua_State *L) {
   lua_pushvalue(L, -1); /* mt.__index = mt */
   lua_setfield(L, -2, "__index");
   luaL_register (L, NULL, regex_meta);
+  cache_init (L);
 
   /* register functions */
   luaL_register (L, REX_LIBNAME, rexlib);
@@ -171,7 +171,7 @@ int Lpcre_config (lua_State *L) {
   if (lua_istable (L, 1))
     lua_settop (L, 1);
   else
-    lua_newtable (L);
+    lua_createtable (L, 0, sizeof (pcre_config_flags) / sizeof (flag_pair) - 1);
   for (fp = pcre_config_flags; fp->key; ++fp) {
     if (0 == pcre_config (fp->val, &val)) {
       lua_pushinteger (L, val);
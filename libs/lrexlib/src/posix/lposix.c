@@ -273,6 +273,7 @@ static const luaL_reg rexlib[] = {
   { "new",        ud_new },
   { "flags",      Posix_get_flags },
   { "plainfind",  plainfind_func },
+  { "setcachesize", cache_setsize },
   { NULL, NULL }
 };
 
@@ -286,6 +287,7 @@ REX_API int REX_OPENLIB (lua_State *L)
   lua_pushvalue(L, -1); /* mt.__index = mt */
   lua_setfield(L, -2, "__index");
   luaL_register (L, NULL, posixmeta);
+  cache_init (L);
 
   /* register functions */
   luaL_register (L, REX_LIBNAME, rexlib);
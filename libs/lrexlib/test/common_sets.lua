@@ -319,6 +319,78 @@ local function set_f_gsub8 (lib, flg)
   }
 end
 
+local function set_f_setcachesize (lib)
+  -- setcachesize (n)
+  -- the cache tables live in the environment of the functions:
+  -- [11]: key -> regex, [12]: key -> time of last use (see algo.h)
+  local env = debug.getfenv (lib.find)
+  local function cached (patt) -- did find take its regex from the cache?
+    local before = {}
+    for _, ud in pairs (env[11]) do before[ud] = true end
+    lib.find ("", patt)
+    local key, time = nil, -1
+    for k, t in pairs (env[12]) do
+      if t > time then key, time = k, t end
+    end
+    return key ~= nil and before[env[11][key]] == true
+  end
+  local function test_cache (size, ...)
+    local oldsize = lib.setcachesize (size)
+    lib.setcachesize (0) -- start with an empty cache
+    lib.setcachesize (size)
+    local out = {}
+    for i = 1, select ("#", ...) do
+      out[i] = cached (select (i, ...))
+    end
+    lib.setcachesize (oldsize)
+    return unpack (out)
+  end
+  return {
+    Name = "Function setcachesize",
+    Func = test_cache,
+  --{  size  patterns                          results }
+    { {32,   "a","b","a","a"},                 {false,false,true,true}                   },
+    { {0,    "a","a","a"},                     {false,false,false}                       },
+    { {1,    "a","b","a","a","b","b"},         {false,false,false,true,false,true}       },
+    { {2,    "a","b","a","c","b","a"},         {false,false,true,false,false,false}      },
+    { {-1,   "a"},                             "error"                                   },
+    { {"x",  "a"},                             "error"                                   },
+    { {N,    "a"},                             "error"                                   },
+  }
+end
+
+local function set_f_cache_cflags (lib)
+  -- the cached regexes are told apart by cf
+  local flags = lib.flags ()
+  local icase = flags.ICASE or flags.CASELESS or flags.IGNORECASE
+  local function test_cflags (cf1, cf2)
+    return lib.match ("ABC", "abc", 1, cf1), lib.match ("ABC", "abc", 1, cf2)
+  end
+  return {
+    Name = "Function match with cached regexes",
+    Func = test_cflags,
+  --{  cf1    cf2      results }
+    { {icase, N},      {"ABC", N}     },
+    { {N,     icase},  {N,     "ABC"} },
+    { {icase, icase},  {"ABC", "ABC"} },
+  }
+end
+
+local function set_f_gsub9 (lib)
+  -- a callback re-entering gsub with the same (cached) pattern
+  local gsub = get_gsub (lib)
+  local function repl (m)
+    return "<" .. gsub (m, "[0-9]+", "#") .. ">"
+  end
+  return {
+    Name = "Function gsub, set9",
+    Func = gsub,
+  --{  s          p          f     n     res1          res2  res3 }
+    { {"a1b22c",  "[0-9]+",  repl},      {"a<#>b<#>c", 2,    2} },
+    { {"a1b22c",  "[0-9]+",  repl, 1},   {"a<#>b22c",  1,    1} },
+  }
+end
+
 return function (libname)
   local lib = require (libname)
   return {
@@ -338,5 +410,8 @@ return function (libname)
     set_f_gsub6     (lib),
     set_f_gsub8     (lib),
     set_f_plainfind (lib),
+    set_f_setcachesize (lib),
+    set_f_cache_cflags (lib),
+    set_f_gsub9     (lib),
   }
 end
@@ -158,6 +158,107 @@ local function set_m_dfa_exec (lib, flg)
 }
 end
 
+local function set_f_jit (lib, flg)
+  -- gmatch, gsub and split give the same results with and without JIT
+  local function collect (iter)
+    local out, guard = {}, 10
+    for a, b, c in iter do
+      table.insert (out, { norm(a), norm(b), norm(c) })
+      guard = guard - 1
+      if guard == 0 then break end
+    end
+    return out
+  end
+  local function test_jit (on, func, subj, patt, repl)
+    lib.setjit (on)
+    local ok, res = pcall (function ()
+      if func == "gsub" then return { lib.gsub (subj, patt, repl) } end
+      return collect (lib[func] (subj, patt))
+    end)
+    lib.setjit (false)
+    if not ok then error (res) end
+    return unpack (res)
+  end
+  local pKV = "(\\w+)=(\\d*)"
+  local cases = {
+  --{  func      subj          patt   repl},   { results }
+    { {"gmatch", "abcd",       ".*"},         {{"abcd",N,N},{"",N,N}} },
+    { {"gmatch", "a=1, b=, c", pKV},          {{"a","1",N},{"b","",N}} },
+    { {"split",  "ab",         "^|$"},        {{"","",N},{"ab","",N},{"",N,N}} },
+    { {"split",  "a=1, b=, c", pKV},          {{"","a","1"},{", ","b",""},{", c",N,N}} },
+    { {"gsub",   "a2c3",       ".*",  "#"},   {"##",2,2} },
+    { {"gsub",   "a=1, b=, c", pKV,   "%2"},  {"1, , c",2,2} },
+  }
+  local tests = { Name = "Function setjit", Func = test_jit }
+  for _, on in ipairs {true, false} do
+    for _, case in ipairs (cases) do
+      local args = { on, unpack (case[1]) }
+      table.insert (tests, { args, case[2] })
+    end
+  end
+  return tests
+end
+
+local function set_f_setjit_cache (lib, flg)
+  -- setjit empties the regex cache of the functions
+  local env = debug.getfenv (lib.find) -- [11]: key -> regex (see algo.h)
+  local function test_cache (on)
+    lib.find ("", "a")
+    local filled = next (env[11]) ~= nil
+    lib.setjit (on)
+    local emptied = next (env[11]) == nil
+    lib.setjit (false)
+    return filled, emptied
+  end
+  return {
+    Name = "Function setjit and the regex cache",
+    Func = test_cache,
+  --{ jit },     { filled, emptied }
+    { {true},    {true, true} },
+    { {false},   {true, true} },
+  }
+end
+
+local function set_m_setmatchlimit (lib, flg)
+  -- r:setmatchlimit (limit, [limit_recursion])
+  local function result (ok, ...)
+    if ok then return ... end
+    local msg = ...
+    return msg:match ("ERROR_%u+") or msg -- the PCRE error raised
+  end
+  local function test_limit (on, subj, patt, ...)
+    lib.setjit (on)
+    local r = lib.new (patt)
+    lib.setjit (false)
+    r:setmatchlimit (...)
+    return result (pcall (r.find, r, subj))
+  end
+  local nomatch = ("a"):rep(12) .. "cb"  -- (a+)+b backtracks some 1000 times
+  local runaway = ("a"):rep(40) .. "cb"  -- ... and here practically forever
+  local tests = {
+    Name = "Method setmatchlimit",
+    Func = test_limit,
+  --{  jit    subj      patt      limit },    { results }
+    { {false, nomatch,  "(a+)+b", 0},         {N} },
+    { {false, nomatch,  "(a+)+b", 100},       {"ERROR_MATCHLIMIT"} },
+    { {false, runaway,  "(a+)+b", 1000},      {"ERROR_MATCHLIMIT"} },
+    { {true,  nomatch,  "(a+)+b", 0},         {N} },
+    { {true,  runaway,  "(a+)+b", 1000},      {"ERROR_MATCHLIMIT"} },
+    { {false, "aab",    "(a+)+b", 1000},      {1,3,"aa"} },
+    { {false, "aab",    "(a+)+b", -1},        "error" },
+    { {false, "aab",    "(a+)+b", "x"},       "error" },
+    { {false, "aab",    "(a+)+b"},            "error" },
+  }
+  if flg.MAJOR * 100 + flg.MINOR >= 605 then
+    -- no JIT here: JIT code ignores limit_recursion
+    table.insert (tests, { {false, "aab", "(a)+b", 0, 0},    {1,3,"a"} })
+    table.insert (tests, { {false, "aab", "(a)+b", 0, 1},    {"ERROR_RECURSIONLIMIT"} })
+    table.insert (tests, { {false, "aab", "(a)+b", 0, -1},   "error" })
+    table.insert (tests, { {false, "aab", "(a)+b", 0, "x"},  "error" })
+  end
+  return tests
+end
+
 return function (libname)
   local lib = require (libname)
   local flags = lib.flags ()
@@ -175,5 +276,8 @@ return function (libname)
   if flags.MAJOR >= 6 then
     table.insert (sets, set_m_dfa_exec (lib, flags))
   end
+  table.insert (sets, set_f_jit (lib, flags))
+  table.insert (sets, set_f_setjit_cache (lib, flags))
+  table.insert (sets, set_m_setmatchlimit (lib, flags))
   return sets
 end
@@ -433,7 +433,7 @@ LUALIB_API int luaopen_phpserialize(lua_State * L)
 
   LCALL(L, stack);
 
-  lua_newtable(L);
+  lua_createtable(L, 0, 1);
 
   luaL_checkstack(L, NUM_SSI, "luaopen_phpserialize");
   for (i = 1; i <= NUM_SSI; ++i) /* Note string array is one-based */
@@ -695,6 +695,17 @@ LUA_API void lua_rawseti (lua_State *L, int idx, int n) {
 }
 
 
+LUA_API void lua_cleartable (lua_State *L, int idx) {
+  StkId o;
+  lua_lock(L);
+  o = index2adr(L, idx);
+  api_check(L, ttistable(o));
+  luaT_chaincheck(L, hvalue(o));
+  luaH_clear(hvalue(o));
+  lua_unlock(L);
+}
+
+
 LUA_API int lua_setmetatable (lua_State *L, int objindex) {
   TValue *obj;
   Table *mt;
@@ -710,6 +721,7 @@ LUA_API int lua_setmetatable (lua_State *L, int objindex) {
   }
   switch (ttype(obj)) {
     case LUA_TTABLE: {
+      luaT_chaincheck(L, hvalue(obj));
       hvalue(obj)->metatable = mt;
       if (mt)
         luaC_objbarriert(L, hvalue(obj), mt);
@@ -897,6 +909,36 @@ LUA_API int  lua_status (lua_State *L) {
 ** Garbage-collection function
 */
 
+static void setstat (lua_State *L, Table *t, const char *k, lua_Number v) {
+  setnvalue(luaH_setstr(L, t, luaS_new(L, k)), v);
+}
+
+
+static void pushstats (lua_State *L, const GCStats *st) {
+  static const char *const phases[GCNPHASES] = {"pause", "propagate",
+    "sweepstring", "sweep", "finalize", "atomic"};
+  Table *t = luaH_new(L, 0, 12);
+  Table *pt;
+  int i;
+  sethvalue(L, L->top, t);
+  api_incr_top(L);
+  setstat(L, t, "steps", cast_num(st->steps));
+  setstat(L, t, "cycles", cast_num(st->cycles));
+  setstat(L, t, "full", cast_num(st->full));
+  setstat(L, t, "minor", cast_num(st->minor));
+  setstat(L, t, "finalized", cast_num(st->finalized));
+  setstat(L, t, "debt", st->debt);
+  setstat(L, t, "marked", st->marked);
+  setstat(L, t, "freed", st->freed);
+  setstat(L, t, "time", st->total);
+  setstat(L, t, "maxpause", st->maxpause);
+  pt = luaH_new(L, 0, GCNPHASES);
+  sethvalue(L, luaH_setstr(L, t, luaS_newliteral(L, "phases")), pt);
+  for (i = 0; i < GCNPHASES; i++)
+    setstat(L, pt, phases[i], st->time[i]);
+}
+
+
 LUA_API int lua_gc (lua_State *L, int what, int data) {
   int res = 0;
   global_State *g;
@@ -926,6 +968,11 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
     }
     case LUA_GCSTEP: {
       lu_mem a = (cast(lu_mem, data) << 10);
+      if (g->gckind == KGC_GEN) {  /* collections are not incremental */
+        luaC_step(L);  /* one minor (or due major) collection */
+        res = 1;
+        break;
+      }
       if (a <= g->totalbytes)
         g->GCthreshold = g->totalbytes - a;
       else
@@ -936,6 +983,10 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
         res = 1;  /* signal it */
       break;
     }
+    case LUA_GCSTEPTIME: {  /* `data' is a budget in microseconds */
+      res = luaC_steptime(L, cast_num(data) / 1e6);
+      break;
+    }
     case LUA_GCSETPAUSE: {
       res = g->gcpause;
       g->gcpause = data;
@@ -946,6 +997,25 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
       g->gcstepmul = data;
       break;
     }
+    case LUA_GCGEN: {
+      res = (g->gckind == KGC_GEN) ? LUA_GCGEN : LUA_GCINC;
+      if (data != 0)
+        g->gcmajorinc = data;
+      luaC_changemode(L, KGC_GEN);
+      break;
+    }
+    case LUA_GCINC: {
+      res = (g->gckind == KGC_GEN) ? LUA_GCGEN : LUA_GCINC;
+      luaC_changemode(L, KGC_NORMAL);
+      break;
+    }
+    case LUA_GCSTATS: {  /* push a table with the statistics */
+      luaC_checkGC(L);
+      pushstats(L, &g->gcstats);
+      if (data != 0)
+        luaC_resetstats(L);
+      break;
+    }
     default: res = -1;  /* invalid option */
   }
   lua_unlock(L);
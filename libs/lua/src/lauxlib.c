@@ -24,6 +24,12 @@
 
 #include "lauxlib.h"
 
+#if defined(LUA_BCCACHE)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 
 #define FREELIST_REF	0	/* free list of references */
 
@@ -389,53 +395,102 @@ LUALIB_API const char *luaL_findtable (lua_State *L, int idx,
 */
 
 
-#define bufflen(B)	((B)->p - (B)->buffer)
-#define bufffree(B)	((size_t)(LUAL_BUFFERSIZE - bufflen(B)))
+#define bufflen(B)	((size_t)((B)->p - (B)->b))
+#define bufffree(B)	((B)->size - bufflen(B))
 
-#define LIMIT	(LUA_MINSTACK/2)
+#define BUFFERBOX	"_BUFFERBOX"
 
 
-static int emptybuffer (luaL_Buffer *B) {
-  size_t l = bufflen(B);
-  if (l == 0) return 0;  /* put nothing on stack */
-  else {
-    lua_pushlstring(B->L, B->buffer, l);
-    B->p = B->buffer;
-    B->lvl++;
-    return 1;
+/*
+** Contents that outgrow `B->buffer' move into a block held by a userdata
+** box in the stack: the block grows in place, and the box frees it if an
+** error unwinds the stack before `luaL_pushresult'.
+*/
+typedef struct BufferBox {
+  void *block;
+  size_t size;
+} BufferBox;
+
+
+static void *resizebox (lua_State *L, int idx, size_t newsize) {
+  void *ud;
+  lua_Alloc allocf = lua_getallocf(L, &ud);
+  BufferBox *box = (BufferBox *)lua_touserdata(L, idx);
+  void *temp = allocf(ud, box->block, box->size, newsize);
+  if (temp == NULL && newsize > 0) {  /* allocation error? */
+    lua_pushliteral(L, "not enough memory");
+    lua_error(L);  /* box still owns the old block */
   }
+  box->block = temp;
+  box->size = newsize;
+  return temp;
 }
 
 
-static void adjuststack (luaL_Buffer *B) {
-  if (B->lvl > 1) {
+static int boxgc (lua_State *L) {
+  resizebox(L, 1, 0);
+  return 0;
+}
+
+
+static void newbox (lua_State *L) {
+  BufferBox *box = (BufferBox *)lua_newuserdata(L, sizeof(BufferBox));
+  box->block = NULL;
+  box->size = 0;
+  if (luaL_newmetatable(L, BUFFERBOX)) {
+    lua_pushcfunction(L, boxgc);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_setmetatable(L, -2);
+}
+
+
+/*
+** returns a pointer to at least `sz' free bytes; `boxidx' is where the
+** box is (or goes) in the stack: -1, or -2 with a value to add on top
+*/
+static char *prepbuffsize (luaL_Buffer *B, size_t sz, int boxidx) {
+  if (bufffree(B) < sz) {
     lua_State *L = B->L;
-    int toget = 1;  /* number of levels to concat */
-    size_t toplen = lua_strlen(L, -1);
-    do {
-      size_t l = lua_strlen(L, -(toget+1));
-      if (B->lvl - toget + 1 >= LIMIT || toplen > l) {
-        toplen += l;
-        toget++;
-      }
-      else break;
-    } while (toget < B->lvl);
-    lua_concat(L, toget);
-    B->lvl = B->lvl - toget + 1;
+    size_t len = bufflen(B);
+    size_t newsize = B->size * 2;  /* double buffer size */
+    char *newbuff;
+    if (sz > ~(size_t)0 - len)  /* overflow? */
+      luaL_error(L, "buffer too large");
+    if (newsize < len + sz)  /* still not big enough? */
+      newsize = len + sz;
+    if (B->lvl == 0) {  /* contents still in `B->buffer'? */
+      newbox(L);
+      lua_insert(L, boxidx);
+      newbuff = (char *)resizebox(L, boxidx, newsize);
+      memcpy(newbuff, B->b, len);
+      B->lvl = 1;
+    }
+    else
+      newbuff = (char *)resizebox(L, boxidx, newsize);
+    B->b = newbuff;
+    B->p = newbuff + len;
+    B->size = newsize;
   }
+  return B->p;
+}
+
+
+LUALIB_API char *luaL_prepbuffsize (luaL_Buffer *B, size_t sz) {
+  return prepbuffsize(B, sz, -1);
 }
 
 
 LUALIB_API char *luaL_prepbuffer (luaL_Buffer *B) {
-  if (emptybuffer(B))
-    adjuststack(B);
-  return B->buffer;
+  return prepbuffsize(B, LUAL_BUFFERSIZE, -1);
 }
 
 
 LUALIB_API void luaL_addlstring (luaL_Buffer *B, const char *s, size_t l) {
-  while (l--)
-    luaL_addchar(B, *s++);
+  if (l > 0) {
+    memcpy(prepbuffsize(B, l, -1), s, l);
+    luaL_addsize(B, l);
+  }
 }
 
 
@@ -445,9 +500,15 @@ LUALIB_API void luaL_addstring (luaL_Buffer *B, const char *s) {
 
 
 LUALIB_API void luaL_pushresult (luaL_Buffer *B) {
-  emptybuffer(B);
-  lua_concat(B->L, B->lvl);
-  B->lvl = 1;
+  lua_State *L = B->L;
+  lua_pushlstring(L, B->b, bufflen(B));
+  if (B->lvl) {  /* contents in a box? */
+    resizebox(L, -2, 0);  /* free the block now, not at collection */
+    lua_remove(L, -2);
+    B->lvl = 0;
+  }
+  B->b = B->p = B->buffer;
+  B->size = LUAL_BUFFERSIZE;
 }
 
 
@@ -455,23 +516,18 @@ LUALIB_API void luaL_addvalue (luaL_Buffer *B) {
   lua_State *L = B->L;
   size_t vl;
   const char *s = lua_tolstring(L, -1, &vl);
-  if (vl <= bufffree(B)) {  /* fit into buffer? */
-    memcpy(B->p, s, vl);  /* put it there */
-    B->p += vl;
-    lua_pop(L, 1);  /* remove from stack */
-  }
-  else {
-    if (emptybuffer(B))
-      lua_insert(L, -2);  /* put buffer before new value */
-    B->lvl++;  /* add new value into B stack */
-    adjuststack(B);
+  if (vl > 0) {
+    memcpy(prepbuffsize(B, vl, -2), s, vl);  /* box goes below the value */
+    luaL_addsize(B, vl);
   }
+  lua_pop(L, 1);  /* remove value */
 }
 
 
 LUALIB_API void luaL_buffinit (lua_State *L, luaL_Buffer *B) {
   B->L = L;
-  B->p = B->buffer;
+  B->b = B->p = B->buffer;
+  B->size = LUAL_BUFFERSIZE;
   B->lvl = 0;
 }
 
@@ -549,6 +605,169 @@ static int errfile (lua_State *L, const char *what, int fnameindex) {
 }
 
 
+#if defined(LUA_BCCACHE)
+
+/*
+** {======================================================
+** Bytecode cache: `LUA_BCCACHE' names a directory where luaL_loadfile
+** keeps the compiled form of each source file, reused while the path,
+** the modification time and the contents of the file stay the same
+** =======================================================
+*/
+
+#define NOCACHE		(-1)	/* file must be loaded the usual way */
+
+#define CACHEMAGIC	"\033LBC"
+
+typedef struct CacheHeader {
+  char magic[4];
+  unsigned int hash;  /* hash of the source */
+  size_t size;  /* size of the source */
+  time_t mtime;  /* modification time of the source */
+  size_t pathlen;  /* size of the path, which follows the header */
+} CacheHeader;
+
+
+static unsigned int cachehash (const char *s, size_t l) {
+  unsigned int h = 2166136261u;  /* FNV-1a */
+  for (; l > 0; l--)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+  return h;
+}
+
+
+static int cachewriter (lua_State *L, const void *p, size_t size, void *f) {
+  (void)L;
+  return fwrite(p, 1, size, (FILE *)f) != size;
+}
+
+
+/* pushes the contents of file `f' */
+static int readsource (lua_State *L, FILE *f) {
+  luaL_Buffer b;
+  size_t n;
+  luaL_buffinit(L, &b);
+  do {
+    n = fread(luaL_prepbuffer(&b), 1, LUAL_BUFFERSIZE, f);
+    luaL_addsize(&b, n);
+  } while (n == LUAL_BUFFERSIZE);
+  luaL_pushresult(&b);
+  return ferror(f);
+}
+
+
+/* tries to load the chunk stored in `cachefile' for header `h' */
+static int loadfromcache (lua_State *L, const char *cachefile,
+                          const CacheHeader *h, const char *filename,
+                          const char *chunkname) {
+  LoadF lf;
+  CacheHeader ch;
+  int status = 1;
+  lf.extraline = 0;
+  lf.f = fopen(cachefile, "rb");
+  if (lf.f == NULL) return 1;
+  if (fread(&ch, sizeof(ch), 1, lf.f) == 1 &&
+      memcmp(&ch, h, sizeof(ch)) == 0 &&
+      fread(lf.buff, 1, h->pathlen, lf.f) == h->pathlen &&
+      memcmp(lf.buff, filename, h->pathlen) == 0) {
+    status = lua_load(L, getF, &lf, chunkname);
+    if (status == 0 && ferror(lf.f)) status = 1;
+    if (status != 0) lua_pop(L, 1);  /* corrupted entry: recompile */
+  }
+  fclose(lf.f);
+  return status;
+}
+
+
+/* stores the function on the top of the stack in `cachefile' */
+static void storeincache (lua_State *L, const char *cachefile,
+                          const CacheHeader *h, const char *filename) {
+  /* a fresh file of our own, so that no one else can choose where (or
+     along with whom) the entry is written */
+  char *tmp = (char *)lua_newuserdata(L, strlen(cachefile) + 8);
+  FILE *f = NULL;
+  int fd, err;
+  sprintf(tmp, "%s.XXXXXX", cachefile);
+  fd = mkstemp(tmp);
+  if (fd == -1 || (f = fdopen(fd, "wb")) == NULL) {
+    if (fd != -1) {
+      close(fd);
+      remove(tmp);
+    }
+    lua_pop(L, 1);
+    return;  /* no cache then */
+  }
+  lua_pushvalue(L, -2);  /* function */
+  err = fwrite(h, sizeof(*h), 1, f) != 1 ||
+        fwrite(filename, 1, h->pathlen, f) != h->pathlen ||
+        lua_dump(L, cachewriter, f) != 0;
+  lua_pop(L, 1);
+  err = (fclose(f) != 0) || err;
+  /* replace the entry atomically, so concurrent loaders never see
+     it half written */
+  if (err || rename(tmp, cachefile) != 0)
+    remove(tmp);
+  lua_pop(L, 1);  /* tmp */
+}
+
+
+/*
+** loads `filename' through the cache, with its chunk name at `fnameindex'.
+** Returns NOCACHE when the cache is off or does not apply (unreadable or
+** precompiled files, paths too long), leaving the stack untouched.
+*/
+static int cachedload (lua_State *L, const char *filename, int fnameindex) {
+  const char *dir = getenv(LUA_BCCACHE);
+  const char *chunkname = lua_tostring(L, fnameindex);
+  const char *src, *chunk, *first, *cachefile;
+  char entry[24];
+  CacheHeader h;
+  struct stat st;
+  size_t l;
+  FILE *f;
+  int status;
+  if (dir == NULL || *dir == '\0' ||
+      stat(filename, &st) != 0 || !S_ISREG(st.st_mode) ||
+      strlen(filename) > LUAL_BUFFERSIZE)
+    return NOCACHE;
+  f = fopen(filename, "rb");
+  if (f == NULL) return NOCACHE;
+  status = readsource(L, f);
+  fclose(f);
+  src = lua_tolstring(L, -1, &l);
+  chunk = first = src;
+  if (l > 0 && *src == '#') {  /* Unix exec. file? */
+    chunk = (const char *)memchr(src, '\n', l);  /* skip first line */
+    if (chunk == NULL) chunk = src + l;
+    first = chunk + 1;
+  }
+  if (status != 0 || (first < src + l && *first == LUA_SIGNATURE[0])) {
+    lua_pop(L, 1);  /* read error or binary file */
+    return NOCACHE;
+  }
+  memset(&h, 0, sizeof(h));  /* clear padding, compared with memcmp */
+  memcpy(h.magic, CACHEMAGIC, sizeof(h.magic));
+  h.hash = cachehash(src, l);
+  h.size = l;
+  h.mtime = st.st_mtime;
+  h.pathlen = strlen(filename);
+  sprintf(entry, "%08x", cachehash(filename, h.pathlen));
+  cachefile = lua_pushfstring(L, "%s/%s.luac", dir, entry);
+  if (loadfromcache(L, cachefile, &h, filename, chunkname) != 0) {
+    status = luaL_loadbuffer(L, chunk, l - (chunk - src), chunkname);
+    if (status == 0)
+      storeincache(L, cachefile, &h, filename);
+  }
+  lua_replace(L, fnameindex);  /* function or error message */
+  lua_settop(L, fnameindex);
+  return status;
+}
+
+/* }====================================================== */
+
+#endif
+
+
 LUALIB_API int luaL_loadfile (lua_State *L, const char *filename) {
   LoadF lf;
   int status, readstatus;
@@ -561,6 +780,10 @@ LUALIB_API int luaL_loadfile (lua_State *L, const char *filename) {
   }
   else {
     lua_pushfstring(L, "@%s", filename);
+#if defined(LUA_BCCACHE)
+    if ((status = cachedload(L, filename, fnameindex)) != NOCACHE)
+      return status;
+#endif
     lf.f = fopen(filename, "r");
     if (lf.f == NULL) return errfile(L, "open", fnameindex);
   }
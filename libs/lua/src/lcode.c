@@ -837,3 +837,47 @@ void luaK_setlist (FuncState *fs, int base, int nelems, int tostore) {
   fs->freereg = base + 1;  /* free registers with list values */
 }
 
+
+/*
+** replaces instructions of a finished function by their specialised
+** forms: GETTABLE with a constant string key by GETFIELD, ADD and SUB
+** with a constant number by ADDK and SUBK. Functions with GETFIELD or
+** SELF instructions get their inline caches.
+*/
+void luaK_quicken (lua_State *L, Proto *f) {
+  int pc;
+  int cached = 0;
+  for (pc = 0; pc < f->sizecode; pc++) {
+    Instruction *i = &f->code[pc];
+    int c = GETARG_C(*i);
+    switch (GET_OPCODE(*i)) {
+      case OP_GETTABLE: {
+        if (ISK(c) && ttisstring(&f->k[INDEXK(c)])) {
+          SET_OPCODE(*i, OP_GETFIELD);
+          cached = 1;
+        }
+        break;
+      }
+      case OP_SELF: {
+        cached = 1;
+        break;
+      }
+      case OP_ADD: case OP_SUB: {
+        if (ISK(c) && ttisnumber(&f->k[INDEXK(c)]))
+          SET_OPCODE(*i, GET_OPCODE(*i) == OP_ADD ? OP_ADDK : OP_SUBK);
+        break;
+      }
+      case OP_SETLIST: {
+        if (c == 0) pc++;  /* skip extra argument */
+        break;
+      }
+      default: break;
+    }
+  }
+  if (cached && f->icache == NULL) {
+    f->icache = luaM_newvector(L, f->sizecode, ICache);
+    f->sizeicache = f->sizecode;
+    for (pc = 0; pc < f->sizecode; pc++)
+      f->icache[pc].node = 0;
+  }
+}
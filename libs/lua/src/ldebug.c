@@ -386,6 +386,15 @@ static Instruction symbexec (const Proto *pt, int lastpc, int reg) {
         if (reg == a+1) last = pc;
         break;
       }
+      case OP_GETFIELD: {
+        check(ISK(c) && ttisstring(&pt->k[INDEXK(c)]));
+        break;
+      }
+      case OP_ADDK:
+      case OP_SUBK: {
+        check(ISK(c) && ttisnumber(&pt->k[INDEXK(c)]));
+        break;
+      }
       case OP_CONCAT: {
         check(b < c);  /* at least two operands */
         break;
@@ -503,7 +512,7 @@ static const char *getobjname (lua_State *L, CallInfo *ci, int stackpos,
           return getobjname(L, ci, b, name);  /* get name for `b' */
         break;
       }
-      case OP_GETTABLE: {
+      case OP_GETTABLE: case OP_GETFIELD: {
         int k = GETARG_C(i);  /* key index */
         *name = kname(p, k);
         return "field";
@@ -12,6 +12,7 @@
 #include "lua.h"
 
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
 #include "lundump.h"
 
@@ -73,7 +74,19 @@ static void DumpString(const TString* s, DumpState* D)
  }
 }
 
-#define DumpCode(f,D)	 DumpVector(f->code,f->sizecode,sizeof(Instruction),D)
+static void DumpCode(const Proto* f, DumpState* D)
+{
+ int pc,n=f->sizecode;
+ DumpInt(n,D);
+ for (pc=0; pc<n; pc++)			/* write generic opcodes only */
+ {
+  Instruction i=f->code[pc];
+  SET_OPCODE(i,genericop(GET_OPCODE(i)));
+  DumpVar(i,D);
+  if (GET_OPCODE(i)==OP_SETLIST && GETARG_C(i)==0 && pc+1<n)
+   DumpVar(f->code[++pc],D);		/* extra argument of SETLIST */
+ }
+}
 
 static void DumpFunction(const Proto* f, const TString* p, DumpState* D);
 
@@ -27,9 +27,11 @@
 #define GCSWEEPMAX	40
 #define GCSWEEPCOST	10
 #define GCFINALIZECOST	100
+#define GCMINYOUNG	(32*GCSTEPSIZE)  /* least growth between minor GCs */
 
 
-#define maskmarks	cast_byte(~(bitmask(BLACKBIT)|WHITEBITS))
+/* white objects are never old */
+#define maskmarks	cast_byte(~(bitmask(BLACKBIT)|WHITEBITS|bitmask(OLDBIT)))
 
 #define makewhite(g,x)	\
    ((x)->gch.marked = cast_byte(((x)->gch.marked & maskmarks) | luaC_white(g)))
@@ -58,6 +60,10 @@
 
 #define setthreshold(g)  (g->GCthreshold = (g->estimate/100) * g->gcpause)
 
+/* must barriers keep the invariant (no black object points to a white one)? */
+#define keepinvariant(g)  \
+	((g)->gckind == KGC_GEN || (g)->gcstate == GCSpropagate)
+
 
 static void removeentry (Node *n) {
   lua_assert(ttisnil(gval(n)));
@@ -131,6 +137,8 @@ size_t luaC_separateudata (lua_State *L, int all) {
   GCObject **p = &g->mainthread->next;
   GCObject *curr;
   while ((curr = *p) != NULL) {
+    if (!all && isold(curr))
+      break;  /* older udata were separated before (generational mode) */
     if (!(iswhite(curr) || all) || isfinalized(gco2u(curr)))
       p = &curr->gch.next;  /* don't bother with them */
     else if (fasttm(L, gco2u(curr)->metatable, TM_GC) == NULL) {
@@ -313,7 +321,8 @@ static l_mem propagatemark (global_State *g) {
                              sizeof(TValue) * p->sizek + 
                              sizeof(int) * p->sizelineinfo +
                              sizeof(LocVar) * p->sizelocvars +
-                             sizeof(TString *) * p->sizeupvalues;
+                             sizeof(TString *) * p->sizeupvalues +
+                             sizeof(ICache) * p->sizeicache;
     }
     default: lua_assert(0); return 0;
   }
@@ -323,6 +332,7 @@ static l_mem propagatemark (global_State *g) {
 static size_t propagateall (global_State *g) {
   size_t m = 0;
   while (g->gray) m += propagatemark(g);
+  g->gcstats.marked += m;
   return m;
 }
 
@@ -459,6 +469,7 @@ static void GCTM (lua_State *L) {
   if (tm != NULL) {
     lu_byte oldah = L->allowhook;
     lu_mem oldt = g->GCthreshold;
+    g->gcstats.finalized++;
     L->allowhook = 0;  /* stop debug hooks during GC tag method */
     g->GCthreshold = 2*g->totalbytes;  /* avoid GC steps */
     setobj2s(L, L->top, tm);
@@ -497,12 +508,8 @@ static void markmt (global_State *g) {
 }
 
 
-/* mark root set */
-static void markroot (lua_State *L) {
+static void markrootset (lua_State *L) {
   global_State *g = G(L);
-  g->gray = NULL;
-  g->grayagain = NULL;
-  g->weak = NULL;
   markobject(g, g->mainthread);
   /* make global table be traversed before main stack */
   markvalue(g, gt(g->mainthread));
@@ -512,6 +519,16 @@ static void markroot (lua_State *L) {
 }
 
 
+/* mark root set */
+static void markroot (lua_State *L) {
+  global_State *g = G(L);
+  g->gray = NULL;
+  g->grayagain = NULL;
+  g->weak = NULL;
+  markrootset(L);
+}
+
+
 static void remarkupvals (global_State *g) {
   UpVal *uv;
   for (uv = g->uvhead.u.l.next; uv != &g->uvhead; uv = uv->u.l.next) {
@@ -544,6 +561,7 @@ static void atomic (lua_State *L) {
   marktmu(g);  /* mark `preserved' userdata */
   udsize += propagateall(g);  /* remark, to propagate `preserveness' */
   cleartable(g->weak);  /* remove collected objects from weak tables */
+  luaT_chainchanged(L);  /* dead tables and keys may be reused */
   /* flip current white */
   g->currentwhite = cast_byte(otherwhite(g));
   g->sweepstrgc = 0;
@@ -553,29 +571,82 @@ static void atomic (lua_State *L) {
 }
 
 
+/*
+** {======================================================
+** Statistics
+** =======================================================
+*/
+
+/* charge the time since the last charge to phase `p' */
+static void chargetime (global_State *g, int p) {
+  lua_Number now;
+  luai_gcclock(now);
+  g->gcstats.time[p] += now - g->gcstats.mark;
+  g->gcstats.mark = now;
+}
+
+
+static lua_Number startpause (global_State *g) {
+  luai_gcclock(g->gcstats.mark);
+  return g->gcstats.mark;
+}
+
+
+static void endpause (global_State *g, lua_Number start) {
+  lua_Number t;
+  chargetime(g, g->gcstate);
+  t = g->gcstats.mark - start;
+  g->gcstats.total += t;
+  if (t > g->gcstats.maxpause)
+    g->gcstats.maxpause = t;
+}
+
+
+void luaC_resetstats (lua_State *L) {
+  GCStats *st = &G(L)->gcstats;
+  int i;
+  st->steps = st->cycles = st->full = st->minor = st->finalized = 0;
+  st->debt = st->marked = st->freed = 0;
+  st->total = st->maxpause = st->mark = 0;
+  for (i = 0; i < GCNPHASES; i++)
+    st->time[i] = 0;
+}
+
+/* }====================================================== */
+
+
 static l_mem singlestep (lua_State *L) {
   global_State *g = G(L);
   /*lua_checkmemory(L);*/
   switch (g->gcstate) {
     case GCSpause: {
+      chargetime(g, GCSpause);
       markroot(L);  /* start a new collection */
       return 0;
     }
     case GCSpropagate: {
-      if (g->gray)
-        return propagatemark(g);
+      if (g->gray) {
+        l_mem m = propagatemark(g);
+        g->gcstats.marked += m;
+        return m;
+      }
       else {  /* no more `gray' objects */
+        chargetime(g, GCSpropagate);
         atomic(L);  /* finish mark phase */
+        chargetime(g, GCSatomic);
         return 0;
       }
     }
     case GCSsweepstring: {
       lu_mem old = g->totalbytes;
       sweepwholelist(L, &g->strt.hash[g->sweepstrgc++]);
-      if (g->sweepstrgc >= g->strt.size)  /* nothing more to sweep? */
+      if (g->sweepstrgc >= g->strt.size) {  /* nothing more to sweep? */
+        chargetime(g, GCSsweepstring);
         g->gcstate = GCSsweep;  /* end sweep-string phase */
+      }
       lua_assert(old >= g->totalbytes);
       g->estimate -= old - g->totalbytes;
+      g->gcstats.freed += old - g->totalbytes;
       return GCSWEEPCOST;
     }
     case GCSsweep: {
@@ -583,10 +654,12 @@ static l_mem singlestep (lua_State *L) {
       g->sweepgc = sweeplist(L, g->sweepgc, GCSWEEPMAX);
       if (*g->sweepgc == NULL) {  /* nothing more to sweep? */
         checkSizes(L);
+        chargetime(g, GCSsweep);
         g->gcstate = GCSfinalize;  /* end sweep phase */
       }
       lua_assert(old >= g->totalbytes);
       g->estimate -= old - g->totalbytes;
+      g->gcstats.freed += old - g->totalbytes;
       return GCSWEEPMAX*GCSWEEPCOST;
     }
     case GCSfinalize: {
@@ -597,8 +670,10 @@ static l_mem singlestep (lua_State *L) {
         return GCFINALIZECOST;
       }
       else {
+        chargetime(g, GCSfinalize);
         g->gcstate = GCSpause;  /* end collection */
         g->gcdept = 0;
+        g->gcstats.cycles++;
         return 0;
       }
     }
@@ -607,17 +682,128 @@ static l_mem singlestep (lua_State *L) {
 }
 
 
-void luaC_step (lua_State *L) {
+/*
+** {======================================================
+** Generational mode
+** =======================================================
+*/
+
+/*
+** In generational mode every collection is atomic. Objects that survive
+** one become old: they get OLDBIT and keep their color, so later minor
+** collections do not traverse them again. New references from old
+** objects to young ones go through the usual barriers, which always keep
+** the invariant in this mode; objects they mark or make gray, the live
+** threads (left in `grayagain' by `atomic') and the weak tables are
+** carried over to the next collection. As lists grow at their heads, a
+** minor collection sweeps each one only up to its first old object. A
+** major collection whitens everything and starts again from the root set.
+*/
+
+
+static void sweepgen (lua_State *L, GCObject **p, int all) {
   global_State *g = G(L);
-  l_mem lim = (GCSTEPSIZE/100) * g->gcstepmul;
-  if (lim == 0)
-    lim = (MAX_LUMEM-1)/2;  /* no limit */
-  g->gcdept += g->totalbytes - g->GCthreshold;
-  do {
-    lim -= singlestep(L);
-    if (g->gcstate == GCSpause)
-      break;
-  } while (lim > 0);
+  int deadmask = otherwhite(g);
+  GCObject *curr;
+  while ((curr = *p) != NULL) {
+    if (!all && isold(curr))
+      break;  /* rest of the list is old */
+    if ((curr->gch.marked ^ WHITEBITS) & deadmask) {  /* not dead? */
+      l_setbit(curr->gch.marked, OLDBIT);  /* keep its color; it is old now */
+      p = &curr->gch.next;
+    }
+    else {  /* must erase `curr' */
+      lua_assert(isdead(g, curr));
+      *p = curr->gch.next;
+      if (curr == g->rootgc)  /* is the first element of the list? */
+        g->rootgc = curr->gch.next;  /* adjust first */
+      freeobj(L, curr);
+    }
+  }
+}
+
+
+static void gencollection (lua_State *L, int minor) {
+  global_State *g = G(L);
+  lu_mem old;
+  GCObject *o;
+  int i;
+  if (minor) {  /* keep what barriers remembered and the old threads */
+    g->weak = NULL;
+    markrootset(L);
+  }
+  else
+    markroot(L);
+  propagateall(g);
+  chargetime(g, GCSpropagate);
+  atomic(L);
+  chargetime(g, GCSatomic);
+  old = g->totalbytes;
+  for (i = 0; i < g->strt.size; i++)
+    sweepgen(L, &g->strt.hash[i], 0);
+  sweepgen(L, &g->rootgc, 0);
+  sweepgen(L, &g->mainthread->next, 0);  /* userdata */
+  for (o = g->grayagain; o != NULL; o = gco2th(o)->gclist)
+    sweepgen(L, &gco2th(o)->openupval, 1);  /* of every live thread */
+  while ((o = g->weak) != NULL) {  /* weak tables stay gray, to be cleared */
+    g->weak = gco2h(o)->gclist;  /* again by each collection */
+    gco2h(o)->gclist = g->grayagain;
+    g->grayagain = o;
+  }
+  lua_assert(old >= g->totalbytes);
+  g->estimate -= old - g->totalbytes;
+  g->gcstats.freed += old - g->totalbytes;
+  checkSizes(L);
+  chargetime(g, GCSsweep);
+  g->gcstate = GCSfinalize;
+  luaC_callGCTM(L);
+  chargetime(g, GCSfinalize);
+  g->gcstate = GCSpause;
+  g->gcdept = 0;
+  g->gcstats.cycles++;
+  if (!minor)
+    g->gcmajorbase = g->estimate;
+  else if (g->estimate > (g->gcmajorbase/100) * g->gcmajorinc)
+    g->gcmajorbase = 0;  /* old data grew too much: next GC is a major one */
+  setthreshold(g);
+  /* a pause of 100% or less would collect again on the next allocation */
+  if (g->GCthreshold < g->totalbytes + GCMINYOUNG)
+    g->GCthreshold = g->totalbytes + GCMINYOUNG;
+}
+
+
+/* restart sweep over all elements (returning them to white and young) */
+static void restartsweep (global_State *g) {
+  g->sweepstrgc = 0;
+  g->sweepgc = &g->rootgc;
+  /* reset other collector lists */
+  g->gray = NULL;
+  g->grayagain = NULL;
+  g->weak = NULL;
+  g->gcstate = GCSsweepstring;
+}
+
+
+void luaC_changemode (lua_State *L, int kind) {
+  global_State *g = G(L);
+  if (kind == g->gckind) return;
+  g->gckind = cast_byte(kind);
+  if (kind == KGC_GEN)
+    luaC_fullgc(L);  /* a major collection makes every live object old */
+  else {  /* make every object white, ready for a normal cycle */
+    lua_Number start = startpause(g);
+    restartsweep(g);
+    while (g->gcstate != GCSfinalize)
+      singlestep(L);
+    endpause(g, start);
+  }
+}
+
+/* }====================================================== */
+
+
+/* sets the threshold for the next step after some incremental work */
+static void stepthreshold (global_State *g) {
   if (g->gcstate != GCSpause) {
     if (g->gcdept < GCSTEPSIZE)
       g->GCthreshold = g->totalbytes + GCSTEPSIZE;  /* - lim/g->gcstepmul;*/
@@ -633,39 +819,107 @@ void luaC_step (lua_State *L) {
 }
 
 
-void luaC_fullgc (lua_State *L) {
+void luaC_step (lua_State *L) {
   global_State *g = G(L);
-  if (g->gcstate <= GCSpropagate) {
-    /* reset sweep marks to sweep all elements (returning them to white) */
-    g->sweepstrgc = 0;
-    g->sweepgc = &g->rootgc;
-    /* reset other collector lists */
-    g->gray = NULL;
-    g->grayagain = NULL;
-    g->weak = NULL;
-    g->gcstate = GCSsweepstring;
+  l_mem lim = (GCSTEPSIZE/100) * g->gcstepmul;
+  lua_Number start;
+  if (g->gckind == KGC_GEN) {
+    if (g->gcmajorbase == 0)  /* old data grew too much? */
+      luaC_fullgc(L);
+    else {
+      start = startpause(g);
+      g->gcstats.minor++;
+      gencollection(L, 1);
+      endpause(g, start);
+    }
+    return;
+  }
+  if (lim == 0)
+    lim = (MAX_LUMEM-1)/2;  /* no limit */
+  g->gcdept += g->totalbytes - g->GCthreshold;
+  g->gcstats.steps++;
+  g->gcstats.debt += g->totalbytes - g->GCthreshold;
+  start = startpause(g);
+  do {
+    lim -= singlestep(L);
+    if (g->gcstate == GCSpause)
+      break;
+  } while (lim > 0);
+  endpause(g, start);
+  stepthreshold(g);
+}
+
+
+/*
+** performs incremental work until `budget' seconds have passed or the
+** cycle ends; returns 1 at the end of a cycle. The clock is read every
+** GCSTEPSIZE units of work. A stopped collector stays stopped, so it only
+** runs when asked to. Generational collections are not incremental: in
+** that mode a whole minor (or due major) collection runs instead.
+*/
+int luaC_steptime (lua_State *L, lua_Number budget) {
+  global_State *g = G(L);
+  lu_mem threshold = g->GCthreshold;
+  lua_Number start, now;
+  l_mem work = 0;
+  if (g->gckind == KGC_GEN) {
+    luaC_step(L);
+    if (threshold == MAX_LUMEM)
+      g->GCthreshold = MAX_LUMEM;
+    return 1;
   }
+  g->gcstats.steps++;
+  now = start = startpause(g);
+  do {
+    work += singlestep(L);
+    if (g->gcstate == GCSpause)
+      break;
+    if (work >= GCSTEPSIZE) {
+      work = 0;
+      luai_gcclock(now);
+    }
+  } while (now - start < budget);
+  endpause(g, start);
+  stepthreshold(g);
+  if (threshold == MAX_LUMEM)
+    g->GCthreshold = MAX_LUMEM;
+  return (g->gcstate == GCSpause);
+}
+
+
+void luaC_fullgc (lua_State *L) {
+  global_State *g = G(L);
+  lua_Number start = startpause(g);
+  g->gcstats.full++;
+  if (g->gcstate <= GCSpropagate || g->gckind == KGC_GEN)
+    restartsweep(g);
   lua_assert(g->gcstate != GCSpause && g->gcstate != GCSpropagate);
   /* finish any pending sweep phase */
   while (g->gcstate != GCSfinalize) {
     lua_assert(g->gcstate == GCSsweepstring || g->gcstate == GCSsweep);
     singlestep(L);
   }
-  markroot(L);
-  while (g->gcstate != GCSpause) {
-    singlestep(L);
+  if (g->gckind == KGC_GEN)
+    gencollection(L, 0);  /* major collection */
+  else {
+    markroot(L);
+    while (g->gcstate != GCSpause) {
+      singlestep(L);
+    }
+    setthreshold(g);
   }
-  setthreshold(g);
+  endpause(g, start);
 }
 
 
 void luaC_barrierf (lua_State *L, GCObject *o, GCObject *v) {
   global_State *g = G(L);
   lua_assert(isblack(o) && iswhite(v) && !isdead(g, v) && !isdead(g, o));
-  lua_assert(g->gcstate != GCSfinalize && g->gcstate != GCSpause);
+  lua_assert(keepinvariant(g) ||
+             (g->gcstate != GCSfinalize && g->gcstate != GCSpause));
   lua_assert(ttype(&o->gch) != LUA_TTABLE);
   /* must keep invariant? */
-  if (g->gcstate == GCSpropagate)
+  if (keepinvariant(g))
     reallymarkobject(g, v);  /* restore invariant */
   else  /* don't mind */
     makewhite(g, o);  /* mark as white just to avoid other barriers */
@@ -676,7 +930,8 @@ void luaC_barrierback (lua_State *L, Table *t) {
   global_State *g = G(L);
   GCObject *o = obj2gco(t);
   lua_assert(isblack(o) && !isdead(g, o));
-  lua_assert(g->gcstate != GCSfinalize && g->gcstate != GCSpause);
+  lua_assert(g->gckind == KGC_GEN ||
+             (g->gcstate != GCSfinalize && g->gcstate != GCSpause));
   black2gray(o);  /* make table gray (again) */
   t->gclist = g->grayagain;
   g->grayagain = o;
@@ -697,8 +952,9 @@ void luaC_linkupval (lua_State *L, UpVal *uv) {
   GCObject *o = obj2gco(uv);
   o->gch.next = g->rootgc;  /* link upvalue into `rootgc' list */
   g->rootgc = o;
+  resetbit(o->gch.marked, OLDBIT);  /* it is now among the young objects */
   if (isgray(o)) { 
-    if (g->gcstate == GCSpropagate) {
+    if (keepinvariant(g)) {
       gray2black(o);  /* closed upvalues need barrier */
       luaC_barrier(L, uv, uv->v);
     }
@@ -225,6 +225,16 @@ typedef union Udata {
 
 
 
+/*
+** Inline cache of a GETFIELD or SELF instruction: position of the node
+** where its key was last found. It is only a hint, checked against the
+** node key on every use.
+*/
+typedef struct ICache {
+  int node;  /* node holding the key in the table */
+} ICache;
+
+
 /*
 ** Function Prototypes
 */
@@ -237,6 +247,8 @@ typedef struct Proto {
   struct LocVar *locvars;  /* information about local variables */
   TString **upvalues;  /* upvalue names */
   TString  *source;
+  ICache *icache;  /* inline caches, indexed by pc */
+  int sizeicache;
   int sizeupvalues;
   int sizek;  /* size of `k' */
   int sizecode;
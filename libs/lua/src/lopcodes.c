@@ -52,6 +52,9 @@ const char *const luaP_opnames[NUM_OPCODES+1] = {
   "CLOSE",
   "CLOSURE",
   "VARARG",
+  "GETFIELD",
+  "ADDK",
+  "SUBK",
   NULL
 };
 
@@ -98,5 +101,8 @@ const lu_byte luaP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 0, OpArgN, OpArgN, iABC)		/* OP_CLOSE */
  ,opmode(0, 1, OpArgU, OpArgN, iABx)		/* OP_CLOSURE */
  ,opmode(0, 1, OpArgU, OpArgN, iABC)		/* OP_VARARG */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_GETFIELD */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_ADDK */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_SUBK */
 };
 
@@ -204,11 +204,21 @@ OP_SETLIST,/*	A B C	R(A)[(C-1)*FPF+i] := R(A+i), 1 <= i <= B	*/
 OP_CLOSE,/*	A 	close all variables in the stack up to (>=) R(A)*/
 OP_CLOSURE,/*	A Bx	R(A) := closure(KPROTO[Bx], R(A), ... ,R(A+n))	*/
 
-OP_VARARG/*	A B	R(A), R(A+1), ..., R(A+B-1) = vararg		*/
+OP_VARARG,/*	A B	R(A), R(A+1), ..., R(A+B-1) = vararg		*/
+
+/* specialised forms of the opcodes above (see luaK_quicken) */
+OP_GETFIELD,/*	A B C	R(A) := R(B)[Kst(C)]		(string key)	*/
+OP_ADDK,/*	A B C	R(A) := RK(B) + Kst(C)		(number)	*/
+OP_SUBK/*	A B C	R(A) := RK(B) - Kst(C)		(number)	*/
 } OpCode;
 
 
-#define NUM_OPCODES	(cast(int, OP_VARARG) + 1)
+#define NUM_OPCODES	(cast(int, OP_SUBK) + 1)
+
+/* generic opcode behind a specialised one */
+#define genericop(o)	((o) == OP_GETFIELD ? OP_GETTABLE : \
+			 (o) == OP_ADDK ? OP_ADD : \
+			 (o) == OP_SUBK ? OP_SUB : (o))
 
 
 
@@ -230,6 +240,10 @@ OP_VARARG/*	A B	R(A), R(A+1), ..., R(A+B-1) = vararg		*/
       (true or false).
 
   (*) All `skips' (pc++) assume that next instruction is a jump
+
+  (*) Specialised opcodes keep the operand encoding of their generic
+      forms (C is still an RK with the constant bit set); they are never
+      written to precompiled chunks.
 ===========================================================================*/
 
 
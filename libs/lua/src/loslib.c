@@ -208,7 +208,15 @@ static int os_setlocale (lua_State *L) {
      "numeric", "time", NULL};
   const char *l = luaL_optstring(L, 1, NULL);
   int op = luaL_checkoption(L, 2, "all", catnames);
-  lua_pushstring(L, setlocale(cat[op], l));
+  const char *res = setlocale(cat[op], l);
+  if (res != NULL && l != NULL && (cat[op] == LC_ALL || cat[op] == LC_CTYPE)) {
+    /* compiled patterns hold character classes of the old locale */
+    lua_getfield(L, LUA_REGISTRYINDEX, LUA_PATTERNCACHE);
+    if (lua_istable(L, -1))
+      lua_cleartable(L, -1);
+    lua_pop(L, 1);
+  }
+  lua_pushstring(L, res);
   return 1;
 }
 
@@ -140,6 +140,30 @@ void luaE_freethread (lua_State *L, lua_State *L1) {
 }
 
 
+#if defined(LUA_FULLHASH)
+/*
+** Mixes the time with addresses of a heap object, a local variable and
+** a function, which ASLR changes from run to run.
+*/
+static unsigned int makeseed (lua_State *L) {
+  size_t buff[3];
+  unsigned int h = luai_makeseed();
+  int i;
+  buff[0] = cast(size_t, L);
+  buff[1] = cast(size_t, &h);
+  buff[2] = cast(size_t, &lua_newstate);
+  for (i = 0; i < 3; i++) {
+    h ^= cast(unsigned int, buff[i] ^ (buff[i] >> 16 >> 16));
+    h = (h ^ (h >> 15)) * 0x2c1b3c6dU;
+    h = (h ^ (h >> 12)) * 0x297a2d39U;
+  }
+  return h ^ (h >> 15);
+}
+#else
+#define makeseed(L)	0
+#endif
+
+
 LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   int i;
   lua_State *L;
@@ -163,10 +187,12 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->strt.size = 0;
   g->strt.nuse = 0;
   g->strt.hash = NULL;
+  g->seed = makeseed(L);
   setnilvalue(registry(L));
   luaZ_initbuffer(L, &g->buff);
   g->panic = NULL;
   g->gcstate = GCSpause;
+  g->gckind = KGC_NORMAL;
   g->rootgc = obj2gco(L);
   g->sweepstrgc = 0;
   g->sweepgc = &g->rootgc;
@@ -177,8 +203,16 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->totalbytes = sizeof(LG);
   g->gcpause = LUAI_GCPAUSE;
   g->gcstepmul = LUAI_GCMUL;
+  g->gcmajorbase = 0;
+  g->gcmajorinc = LUAI_GCMAJOR;
+  luaC_resetstats(L);
   g->gcdept = 0;
   for (i=0; i<NUM_TAGS; i++) g->mt[i] = NULL;
+  g->chainepoch = 1;
+  for (i=0; i<LUAI_CHAINCACHE; i++) {
+    g->chaincache[i].mt = NULL;
+    g->chaincache[i].epoch = 0;
+  }
   if (luaD_rawrunprotected(L, f_luaopen, NULL) != 0) {
     /* memory allocation error: free partial state */
     close_state(L);
@@ -62,15 +62,51 @@ typedef struct CallInfo {
 #define isLua(ci)	(ttisfunction((ci)->func) && f_isLua(ci))
 
 
+/*
+** collector statistics (see `collectgarbage("stats")')
+*/
+#define GCNPHASES	6  /* the states of the collector plus `atomic' */
+
+typedef struct GCStats {
+  lu_mem steps;  /* number of incremental steps */
+  lu_mem cycles;  /* number of finished cycles */
+  lu_mem full;  /* number of full (or major) collections */
+  lu_mem minor;  /* number of minor collections */
+  lu_mem finalized;  /* number of finalizers called */
+  lua_Number debt;  /* bytes allocated over the threshold when steps ran */
+  lua_Number marked;  /* bytes traversed by the mark phase */
+  lua_Number freed;  /* bytes freed by the sweep phases */
+  lua_Number total;  /* time (in seconds) spent in the collector */
+  lua_Number maxpause;  /* longest single step or collection */
+  lua_Number time[GCNPHASES];  /* time spent in each phase */
+  lua_Number mark;  /* when time was last charged to a phase */
+} GCStats;
+
+
+/*
+** entry of the cache of resolved `__index' chains: value of `key' as
+** seen through metatable `mt' (valid while `epoch' is current)
+*/
+typedef struct ChainEntry {
+  struct Table *mt;
+  TString *key;
+  TValue val;
+  unsigned int epoch;
+} ChainEntry;
+
+
+
 /*
 ** `global state', shared by all threads of this state
 */
 typedef struct global_State {
   stringtable strt;  /* hash table for strings */
+  unsigned int seed;  /* randomized seed for string hashes */
   lua_Alloc frealloc;  /* function to reallocate memory */
   void *ud;         /* auxiliary data to `frealloc' */
   lu_byte currentwhite;
   lu_byte gcstate;  /* state of garbage collector */
+  lu_byte gckind;  /* kind of GC running (normal or generational) */
   int sweepstrgc;  /* position of sweep in `strt' */
   GCObject *rootgc;  /* list of all collectable objects */
   GCObject **sweepgc;  /* position of sweep in `rootgc' */
@@ -85,12 +121,17 @@ typedef struct global_State {
   lu_mem gcdept;  /* how much GC is `behind schedule' */
   int gcpause;  /* size of pause between successive GCs */
   int gcstepmul;  /* GC `granularity' */
+  lu_mem gcmajorbase;  /* bytes in use after the last major collection */
+  int gcmajorinc;  /* growth over `gcmajorbase' that calls a major GC */
+  GCStats gcstats;  /* collector statistics */
   lua_CFunction panic;  /* to be called in unprotected errors */
   TValue l_registry;
   struct lua_State *mainthread;
   UpVal uvhead;  /* head of double-linked list of all open upvalues */
   struct Table *mt[NUM_TAGS];  /* metatables for basic types */
   TString *tmname[TM_N];  /* array with tag-method names */
+  unsigned int chainepoch;  /* current epoch of `chaincache' */
+  ChainEntry chaincache[LUAI_CHAINCACHE];  /* resolved `__index' chains */
 } global_State;
 
 
@@ -44,6 +44,8 @@ void luaS_resize (lua_State *L, int newsize) {
   luaM_freearray(L, tb->hash, tb->size, TString *);
   tb->size = newsize;
   tb->hash = newhash;
+  if (G(L)->gckind == KGC_GEN)  /* lists are no longer ordered by age? */
+    G(L)->gcmajorbase = 0;  /* next collection must be a major one */
 }
 
 
@@ -72,13 +74,59 @@ static TString *newlstr (lua_State *L, const char *str, size_t l,
 }
 
 
-TString *luaS_newlstr (lua_State *L, const char *str, size_t l) {
-  GCObject *o;
+#if defined(LUA_FULLHASH)
+
+#define rotl32(x,n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+#define mixword(h,k) \
+  { k *= 0xcc9e2d51U; k = rotl32(k, 15); k *= 0x1b873593U; \
+    h ^= k; h = rotl32(h, 13); h = h*5 + 0xe6546b64U; }
+
+/*
+** hash all chars of the string, 4 at a time (after MurmurHash3); the
+** random seed of the state decides which strings collide
+*/
+static unsigned int hashstr (lua_State *L, const char *str, size_t l) {
+  lu_int32 h = cast(lu_int32, G(L)->seed) ^ cast(lu_int32, l);
+  lu_int32 k;
+  const char *e = str + (l & ~cast(size_t, 3));
+  for (; str < e; str += 4) {
+    memcpy(&k, str, 4);  /* word may be unaligned */
+    mixword(h, k);
+  }
+  k = 0;
+  switch (l & 3) {  /* remaining chars */
+    case 3: k ^= cast(lu_int32, cast(unsigned char, str[2])) << 16;
+      /* fallthrough */
+    case 2: k ^= cast(lu_int32, cast(unsigned char, str[1])) << 8;
+      /* fallthrough */
+    case 1: k ^= cast(lu_int32, cast(unsigned char, str[0]));
+      mixword(h, k);
+  }
+  h ^= h >> 16; h *= 0x85ebca6bU;
+  h ^= h >> 13; h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+  return cast(unsigned int, h);
+}
+
+#else
+
+static unsigned int hashstr (lua_State *L, const char *str, size_t l) {
   unsigned int h = cast(unsigned int, l);  /* seed */
   size_t step = (l>>5)+1;  /* if string is too long, don't hash all its chars */
   size_t l1;
+  UNUSED(L);
   for (l1=l; l1>=step; l1-=step)  /* compute hash */
     h = h ^ ((h<<5)+(h>>2)+cast(unsigned char, str[l1-1]));
+  return h;
+}
+
+#endif
+
+
+TString *luaS_newlstr (lua_State *L, const char *str, size_t l) {
+  GCObject *o;
+  unsigned int h = hashstr(L, str, l);
   for (o = G(L)->strt.hash[lmod(h, G(L)->strt.size)];
        o != NULL;
        o = o->gch.next) {
@@ -6,6 +6,7 @@
 
 
 #include <ctype.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -95,6 +96,11 @@ static int str_rep (lua_State *L) {
   const char *s = luaL_checklstring(L, 1, &l);
   int n = luaL_checkint(L, 2);
   luaL_buffinit(L, &b);
+  if (n > 0 && l > 0) {
+    if (l > ~(size_t)0 / (size_t)n)
+      return luaL_error(L, "resulting string too large");
+    luaL_prepbuffsize(&b, l * n);  /* allocate the result at once */
+  }
   while (n-- > 0)
     luaL_addlstring(&b, s, l);
   luaL_pushresult(&b);
@@ -440,28 +446,565 @@ static const char *match (MatchState *ms, const char *s, const char *p) {
 
 
 
+/* false first-byte candidates tolerated before `lmemfind' goes Two-Way */
+#define MAXMISSES	16
+
+
+static size_t maxsuffix (const unsigned char *n, size_t l, int rev,
+                         size_t *period) {
+  size_t ip = (size_t)-1;  /* start of the suffix, minus 1 */
+  size_t jp = 0, k = 1, p = 1;
+  while (jp+k < l) {
+    unsigned char a = n[ip+k], b = n[jp+k];
+    if (a == b) {
+      if (k == p) { jp += p; k = 1; }
+      else k++;
+    }
+    else if (rev ? a < b : a > b) {
+      jp += k; k = 1;
+      p = jp - ip;
+    }
+    else {
+      ip = jp++;
+      k = p = 1;
+    }
+  }
+  *period = p;
+  return ip;
+}
+
+
+/*
+** Two-Way string matching (Crochemore-Perrin) of `n' (l > 1) inside
+** `h', skipping windows by their last byte; linear in the worst case.
+*/
+static const char *twoway (const unsigned char *h, size_t lh,
+                           const unsigned char *n, size_t l) {
+  const unsigned char *z = h + lh;
+  size_t ms, ms2, p, p2, mem, mem0, i, k;
+  unsigned char byteset[(UCHAR_MAX+1)/CHAR_BIT];
+  size_t shift[UCHAR_MAX+1];  /* valid for bytes in `byteset' only */
+  memset(byteset, 0, sizeof(byteset));
+  for (i = 0; i < l; i++) {
+    byteset[n[i]/CHAR_BIT] |= 1 << (n[i]%CHAR_BIT);
+    shift[n[i]] = i+1;
+  }
+  /* critical factorization: the larger of both maximal suffixes */
+  ms = maxsuffix(n, l, 0, &p);
+  ms2 = maxsuffix(n, l, 1, &p2);
+  if (ms2+1 > ms+1) { ms = ms2; p = p2; }
+  if (memcmp(n, n+p, ms+1) != 0) {  /* not periodic? */
+    mem0 = 0;
+    p = ((ms > l-ms-1) ? ms : l-ms-1) + 1;
+  }
+  else mem0 = l-p;
+  mem = 0;
+  while ((size_t)(z-h) >= l) {
+    unsigned char c = h[l-1];  /* last byte of the window */
+    if (!(byteset[c/CHAR_BIT] & (1 << (c%CHAR_BIT)))) {
+      h += l; mem = 0;
+      continue;
+    }
+    k = l-shift[c];
+    if (k) {
+      h += (k < mem) ? mem : k; mem = 0;
+      continue;
+    }
+    for (k = (ms+1 > mem) ? ms+1 : mem; k < l && n[k] == h[k]; k++) ;
+    if (k < l) {  /* mismatch in the right half */
+      h += k-ms; mem = 0;
+      continue;
+    }
+    for (k = ms+1; k > mem && n[k-1] == h[k-1]; k--) ;
+    if (k <= mem) return (const char *)h;
+    h += p; mem = mem0;
+  }
+  return NULL;
+}
+
+
 static const char *lmemfind (const char *s1, size_t l1,
                                const char *s2, size_t l2) {
   if (l2 == 0) return s1;  /* empty strings are everywhere */
   else if (l2 > l1) return NULL;  /* avoids a negative `l1' */
+  else if (l2 == 1) return (const char *)memchr(s1, *s2, l1);
   else {
     const char *init;  /* to search for a `*s2' inside `s1' */
-    l2--;  /* 1st char will be checked by `memchr' */
-    l1 = l1-l2;  /* `s2' cannot be found after that */
-    while (l1 > 0 && (init = (const char *)memchr(s1, *s2, l1)) != NULL) {
-      init++;   /* 1st char is already checked */
-      if (memcmp(init, s2+1, l2) == 0)
-        return init-1;
-      else {  /* correct `l1' and `s1' to try again */
-        l1 -= init-s1;
-        s1 = init;
-      }
+    const char *end = s1+l1;
+    const char *last = end-l2;  /* `s2' cannot be found after that */
+    int misses = 0;
+    while (s1 <= last &&
+           (init = (const char *)memchr(s1, *s2, last-s1+1)) != NULL) {
+      /* check last char before the rest */
+      if (init[l2-1] == s2[l2-1] && memcmp(init+1, s2+1, l2-2) == 0)
+        return init;
+      s1 = init+1;
+      if (++misses == MAXMISSES)  /* common first char? */
+        return twoway((const unsigned char *)s1, end-s1,
+                      (const unsigned char *)s2, l2);
     }
     return NULL;  /* not found */
   }
 }
 
 
+/*
+** Compiled patterns: a pattern is translated once into a list of items
+** with precomputed class bitmaps; programs are cached per state, keyed
+** by the pattern string, in the (weak) environment of the functions.
+** Patterns the compiler cannot prove valid are left to `match', which
+** raises the usual errors.
+*/
+
+
+/* item opcodes */
+#define PI_END		0	/* end of pattern */
+#define PI_DOLLAR	1	/* `$' at end of pattern */
+#define PI_STR		2	/* `len' literal characters */
+#define PI_CHAR		3	/* single (repeated) character */
+#define PI_SET		4	/* single (repeated) character class */
+#define PI_OPEN		5	/* start capture */
+#define PI_POSITION	6	/* position capture */
+#define PI_CLOSE	7	/* end capture */
+#define PI_BALANCE	8	/* %b */
+#define PI_FRONTIER	9	/* %f */
+#define PI_BACKREF	10	/* %1-%9 */
+
+#define SETSIZE		((UCHAR_MAX+1)/CHAR_BIT)
+#define setbit(st,c)	((st)[(c)/CHAR_BIT] |= (1 << ((c)%CHAR_BIT)))
+#define testbit(st,c)	((st)[(c)/CHAR_BIT] & (1 << ((c)%CHAR_BIT)))
+
+typedef struct PatItem {
+  unsigned char op;
+  unsigned char rep;  /* `?', `*', `+', `-' or 0 */
+  unsigned char c;  /* character, capture index or %b opening delimiter */
+  unsigned char c2;  /* %b closing delimiter */
+  size_t len;  /* length of a PI_STR */
+  const unsigned char *set;  /* class bitmap or PI_STR characters */
+} PatItem;
+
+typedef struct Pattern {
+  int anchor;  /* pattern starts with `^'? */
+  const PatItem *prefix;  /* literal every match starts with, or NULL */
+  int firstc;  /* character every match starts with, or -1 */
+  const unsigned char *first;  /* class every match starts with, or NULL */
+  PatItem item[1];  /* followed by class bitmaps and literal characters */
+} Pattern;
+
+typedef struct CompileState {
+  PatItem *item;  /* NULL when only sizing the program */
+  unsigned char *data;
+  size_t nitems;
+  size_t ndata;
+  int lastop;
+  PatItem scratch;
+} CompileState;
+
+
+static const char *pclassend (const char *p) {
+  switch (*p++) {
+    case L_ESC: {
+      return (*p == '\0') ? NULL : p+1;
+    }
+    case '[': {
+      if (*p == '^') p++;
+      do {  /* look for a `]' */
+        if (*p == '\0') return NULL;
+        if (*(p++) == L_ESC && *p != '\0')
+          p++;  /* skip escapes (e.g. `%]') */
+      } while (*p != ']');
+      return p+1;
+    }
+    default: {
+      return p;
+    }
+  }
+}
+
+
+static PatItem *additem (CompileState *cs, int op) {
+  PatItem *it = (cs->item) ? &cs->item[cs->nitems] : &cs->scratch;
+  cs->nitems++;
+  cs->lastop = op;
+  it->op = uchar(op);
+  it->rep = it->c = it->c2 = 0;
+  it->len = 0;
+  it->set = NULL;
+  return it;
+}
+
+
+static unsigned char *adddata (CompileState *cs, size_t n) {
+  unsigned char *d = (cs->data) ? cs->data + cs->ndata : NULL;
+  cs->ndata += n;
+  return d;
+}
+
+
+static const unsigned char *addset (CompileState *cs, const char *p,
+                                      const char *ep) {
+  unsigned char *st = adddata(cs, SETSIZE);
+  if (st) {
+    int c;
+    memset(st, 0, SETSIZE);
+    for (c = 0; c <= UCHAR_MAX; c++)
+      if (singlematch(c, p, ep)) setbit(st, c);
+  }
+  return st;
+}
+
+
+static void addliteral (CompileState *cs, int c) {
+  unsigned char *d = adddata(cs, 1);
+  if (cs->lastop != PI_STR) {  /* start a new run? */
+    PatItem *it = additem(cs, PI_STR);
+    it->set = d;
+  }
+  if (d) {
+    *d = uchar(c);
+    cs->item[cs->nitems-1].len++;
+  }
+}
+
+
+/*
+** Mirrors `match': returns 0 wherever `match' could raise an error.
+** Capture levels are static along a pattern, so captures to close and
+** back references are resolved here.
+*/
+static int pcompile (CompileState *cs, const char *p) {
+  int level = 0;  /* captures started so far */
+  int nopen = 0;
+  int open[LUA_MAXCAPTURES];  /* unfinished captures */
+  char done[LUA_MAXCAPTURES];  /* capture may be back-referenced? */
+  PatItem *it;
+  for (;;) {
+    switch (*p) {
+      case '(': {
+        if (level >= LUA_MAXCAPTURES) return 0;  /* too many captures */
+        if (*(p+1) == ')') {  /* position capture? */
+          it = additem(cs, PI_POSITION);
+          done[level] = 1;
+          p += 2;
+        }
+        else {
+          it = additem(cs, PI_OPEN);
+          open[nopen++] = level;
+          done[level] = 0;
+          p++;
+        }
+        it->c = uchar(level++);
+        continue;
+      }
+      case ')': {
+        if (nopen == 0) return 0;  /* invalid pattern capture */
+        it = additem(cs, PI_CLOSE);
+        it->c = uchar(open[--nopen]);
+        done[it->c] = 1;
+        p++;
+        continue;
+      }
+      case L_ESC: {
+        switch (*(p+1)) {
+          case 'b': {
+            if (*(p+2) == '\0' || *(p+3) == '\0') return 0;  /* unbalanced */
+            it = additem(cs, PI_BALANCE);
+            it->c = uchar(*(p+2));
+            it->c2 = uchar(*(p+3));
+            p += 4;
+            continue;
+          }
+          case 'f': {
+            const char *ep;
+            p += 2;
+            if (*p != '[' || (ep = pclassend(p)) == NULL) return 0;
+            it = additem(cs, PI_FRONTIER);
+            it->set = addset(cs, p, ep);
+            p = ep;
+            continue;
+          }
+          default: {
+            if (isdigit(uchar(*(p+1)))) {
+              int l = *(p+1) - '1';
+              if (l < 0 || l >= level || !done[l]) return 0;
+              it = additem(cs, PI_BACKREF);
+              it->c = uchar(l);
+              p += 2;
+              continue;
+            }
+            goto dflt;
+          }
+        }
+      }
+      case '\0': {
+        additem(cs, PI_END);
+        return 1;
+      }
+      case '$': {
+        if (*(p+1) == '\0') {
+          additem(cs, PI_DOLLAR);
+          return 1;
+        }
+        else goto dflt;
+      }
+      default: dflt: {
+        const char *ep = pclassend(p);
+        int literal, rep;
+        if (ep == NULL) return 0;  /* malformed class */
+        literal = (*p == L_ESC) ? !isalnum(uchar(*(p+1)))
+                                : (*p != '.' && *p != '[');
+        rep = (*ep != '\0' && strchr("?*+-", *ep) != NULL) ? *ep : 0;
+        if (literal && !rep)
+          addliteral(cs, uchar(*(ep-1)));
+        else if (literal) {
+          it = additem(cs, PI_CHAR);
+          it->c = uchar(*(ep-1));
+          it->rep = uchar(rep);
+        }
+        else {
+          it = additem(cs, PI_SET);
+          it->set = addset(cs, p, ep);
+          it->rep = uchar(rep);
+        }
+        p = (rep) ? ep+1 : ep;
+        continue;
+      }
+    }
+  }
+}
+
+
+static void setfirst (Pattern *pt) {
+  const PatItem *pi = pt->item;
+  while (pi->op == PI_OPEN || pi->op == PI_POSITION) pi++;
+  pt->prefix = NULL;
+  pt->firstc = -1;
+  pt->first = NULL;
+  if (pi->op == PI_STR)
+    pt->prefix = pi;
+  else if (pi->op == PI_BALANCE)
+    pt->firstc = pi->c;
+  else if (pi->rep == 0 || pi->rep == '+') {  /* at least one repetition */
+    if (pi->op == PI_CHAR) pt->firstc = pi->c;
+    else if (pi->op == PI_SET) pt->first = pi->set;
+  }
+}
+
+
+/* pushes the compiled form of pattern `p' (or nil, if it has none) */
+static const Pattern *newpattern (lua_State *L, const char *p) {
+  CompileState cs;
+  Pattern *pt;
+  int anchor = (*p == '^') ? (p++, 1) : 0;
+  cs.item = NULL;
+  cs.data = NULL;
+  cs.nitems = cs.ndata = 0;
+  cs.lastop = PI_END;
+  if (!pcompile(&cs, p)) {
+    lua_pushnil(L);
+    return NULL;
+  }
+  pt = (Pattern *)lua_newuserdata(L, sizeof(Pattern) +
+                                  (cs.nitems-1)*sizeof(PatItem) + cs.ndata);
+  cs.item = pt->item;
+  cs.data = (unsigned char *)(pt->item + cs.nitems);
+  cs.nitems = cs.ndata = 0;
+  cs.lastop = PI_END;
+  pcompile(&cs, p);
+  pt->anchor = anchor;
+  setfirst(pt);
+  return pt;
+}
+
+
+/*
+** pushes the compiled form of the pattern at `arg' (or nil); it must
+** stay on the stack while in use
+*/
+static const Pattern *getpattern (lua_State *L, int arg) {
+  const Pattern *pt;
+  lua_pushvalue(L, arg);
+  lua_rawget(L, LUA_ENVIRONINDEX);
+  pt = (const Pattern *)lua_touserdata(L, -1);
+  if (pt == NULL) {
+    lua_pop(L, 1);
+    pt = newpattern(L, lua_tostring(L, arg));
+    if (pt != NULL) {
+      lua_pushvalue(L, arg);
+      lua_pushvalue(L, -2);
+      lua_rawset(L, LUA_ENVIRONINDEX);
+    }
+  }
+  return pt;
+}
+
+
+/* skips positions of `s' where no match of `pt' can start */
+static const char *pskip (const Pattern *pt, const char *s, const char *e) {
+  if (pt->prefix) {
+    s = lmemfind(s, e - s, (const char *)pt->prefix->set, pt->prefix->len);
+    return (s) ? s : e;
+  }
+  else if (pt->firstc >= 0) {
+    s = (const char *)memchr(s, pt->firstc, e - s);
+    return (s) ? s : e;
+  }
+  else if (pt->first) {
+    while (s < e && !testbit(pt->first, uchar(*s))) s++;
+  }
+  return s;
+}
+
+
+#define itemmatch(pi,ch) \
+	((pi)->op == PI_CHAR ? (ch) == (pi)->c : testbit((pi)->set, ch))
+
+
+static const char *cmatch (MatchState *ms, const char *s, const PatItem *pi);
+
+
+static const char *cmatchbalance (MatchState *ms, const char *s,
+                                    const PatItem *pi) {
+  if (uchar(*s) != pi->c) return NULL;
+  else {
+    int cont = 1;
+    while (++s < ms->src_end) {
+      if (uchar(*s) == pi->c2) {
+        if (--cont == 0) return s+1;
+      }
+      else if (uchar(*s) == pi->c) cont++;
+    }
+  }
+  return NULL;  /* string ends out of balance */
+}
+
+
+static const char *cmax_expand (MatchState *ms, const char *s,
+                                  const PatItem *pi) {
+  ptrdiff_t i = 0;  /* counts maximum expand for item */
+  while ((s+i)<ms->src_end && itemmatch(pi, uchar(*(s+i))))
+    i++;
+  if ((pi+1)->op == PI_END)  /* nothing else to match? */
+    return s+i;
+  /* keeps trying to match with the maximum repetitions */
+  while (i>=0) {
+    const char *res = cmatch(ms, (s+i), pi+1);
+    if (res) return res;
+    i--;  /* else didn't match; reduce 1 repetition to try again */
+  }
+  return NULL;
+}
+
+
+static const char *cmin_expand (MatchState *ms, const char *s,
+                                  const PatItem *pi) {
+  for (;;) {
+    const char *res = cmatch(ms, s, pi+1);
+    if (res != NULL)
+      return res;
+    else if (s<ms->src_end && itemmatch(pi, uchar(*s)))
+      s++;  /* try with one more repetition */
+    else return NULL;
+  }
+}
+
+
+static const char *cstart_capture (MatchState *ms, const char *s,
+                                     const PatItem *pi, int what) {
+  const char *res;
+  int level = ms->level;
+  ms->capture[level].init = s;
+  ms->capture[level].len = what;
+  ms->level = level+1;
+  if ((res=cmatch(ms, s, pi)) == NULL)  /* match failed? */
+    ms->level--;  /* undo capture */
+  return res;
+}
+
+
+static const char *cend_capture (MatchState *ms, const char *s,
+                                   const PatItem *pi) {
+  int l = pi->c;
+  const char *res;
+  ms->capture[l].len = s - ms->capture[l].init;  /* close capture */
+  if ((res = cmatch(ms, s, pi+1)) == NULL)  /* match failed? */
+    ms->capture[l].len = CAP_UNFINISHED;  /* undo capture */
+  return res;
+}
+
+
+static const char *cmatch (MatchState *ms, const char *s, const PatItem *pi) {
+  init: /* using goto's to optimize tail recursion */
+  switch (pi->op) {
+    case PI_END: {
+      return s;  /* match succeeded */
+    }
+    case PI_DOLLAR: {
+      return (s == ms->src_end) ? s : NULL;
+    }
+    case PI_STR: {
+      if ((size_t)(ms->src_end-s) < pi->len ||
+          memcmp(s, pi->set, pi->len) != 0) return NULL;
+      s += pi->len; pi++; goto init;
+    }
+    case PI_OPEN: {
+      return cstart_capture(ms, s, pi+1, CAP_UNFINISHED);
+    }
+    case PI_POSITION: {
+      return cstart_capture(ms, s, pi+1, CAP_POSITION);
+    }
+    case PI_CLOSE: {
+      return cend_capture(ms, s, pi);
+    }
+    case PI_BALANCE: {
+      s = cmatchbalance(ms, s, pi);
+      if (s == NULL) return NULL;
+      pi++; goto init;
+    }
+    case PI_FRONTIER: {
+      int previous = (s == ms->src_init) ? '\0' : uchar(*(s-1));
+      if (testbit(pi->set, previous) || !testbit(pi->set, uchar(*s)))
+        return NULL;
+      pi++; goto init;
+    }
+    case PI_BACKREF: {
+      size_t len = ms->capture[pi->c].len;
+      if ((size_t)(ms->src_end-s) < len ||
+          memcmp(ms->capture[pi->c].init, s, len) != 0) return NULL;
+      s += len; pi++; goto init;
+    }
+    default: {  /* PI_CHAR or PI_SET */
+      int m = s<ms->src_end && itemmatch(pi, uchar(*s));
+      switch (pi->rep) {
+        case '?': {  /* optional */
+          const char *res;
+          if (m && ((res=cmatch(ms, s+1, pi+1)) != NULL))
+            return res;
+          pi++; goto init;  /* else return cmatch(ms, s, pi+1); */
+        }
+        case '*': {  /* 0 or more repetitions */
+          return cmax_expand(ms, s, pi);
+        }
+        case '+': {  /* 1 or more repetitions */
+          return (m ? cmax_expand(ms, s+1, pi) : NULL);
+        }
+        case '-': {  /* 0 or more repetitions (minimum) */
+          return cmin_expand(ms, s, pi);
+        }
+        default: {
+          if (!m) return NULL;
+          s++; pi++; goto init;  /* else return cmatch(ms, s+1, pi+1); */
+        }
+      }
+    }
+  }
+}
+
+
+#define domatch(ms,pt,s,p) \
+	((pt) ? cmatch(ms, s, (pt)->item) : match(ms, s, p))
+
+
 static void push_onecapture (MatchState *ms, int i, const char *s,
                                                     const char *e) {
   if (i >= ms->level) {
@@ -510,6 +1053,7 @@ static int str_find_aux (lua_State *L, int find) {
   }
   else {
     MatchState ms;
+    const Pattern *pt = getpattern(L, 2);
     int anchor = (*p == '^') ? (p++, 1) : 0;
     const char *s1=s+init;
     ms.L = L;
@@ -518,7 +1062,8 @@ static int str_find_aux (lua_State *L, int find) {
     do {
       const char *res;
       ms.level = 0;
-      if ((res=match(&ms, s1, p)) != NULL) {
+      if (pt && !anchor) s1 = pskip(pt, s1, ms.src_end);
+      if ((res=domatch(&ms, pt, s1, p)) != NULL) {
         if (find) {
           lua_pushinteger(L, s1-s+1);  /* start */
           lua_pushinteger(L, res-s);   /* end */
@@ -549,6 +1094,7 @@ static int gmatch_aux (lua_State *L) {
   size_t ls;
   const char *s = lua_tolstring(L, lua_upvalueindex(1), &ls);
   const char *p = lua_tostring(L, lua_upvalueindex(2));
+  const Pattern *pt = (const Pattern *)lua_touserdata(L, lua_upvalueindex(4));
   const char *src;
   ms.L = L;
   ms.src_init = s;
@@ -558,7 +1104,8 @@ static int gmatch_aux (lua_State *L) {
        src++) {
     const char *e;
     ms.level = 0;
-    if ((e = match(&ms, src, p)) != NULL) {
+    if (pt) src = pskip(pt, src, ms.src_end);
+    if ((e = domatch(&ms, pt, src, p)) != NULL) {
       lua_Integer newstart = e-s;
       if (e == src) newstart++;  /* empty match? go at least one position */
       lua_pushinteger(L, newstart);
@@ -575,7 +1122,11 @@ static int gmatch (lua_State *L) {
   luaL_checkstring(L, 2);
   lua_settop(L, 2);
   lua_pushinteger(L, 0);
-  lua_pushcclosure(L, gmatch_aux, 3);
+  if (*lua_tostring(L, 2) == '^')  /* not an anchor here */
+    lua_pushnil(L);
+  else
+    getpattern(L, 2);
+  lua_pushcclosure(L, gmatch_aux, 4);
   return 1;
 }
 
@@ -648,11 +1199,13 @@ static int str_gsub (lua_State *L) {
   int max_s = luaL_optint(L, 4, srcl+1);
   int anchor = (*p == '^') ? (p++, 1) : 0;
   int n = 0;
+  const Pattern *pt;
   MatchState ms;
   luaL_Buffer b;
   luaL_argcheck(L, tr == LUA_TNUMBER || tr == LUA_TSTRING ||
                    tr == LUA_TFUNCTION || tr == LUA_TTABLE, 3,
                       "string/function/table expected");
+  pt = getpattern(L, 2);
   luaL_buffinit(L, &b);
   ms.L = L;
   ms.src_init = src;
@@ -660,15 +1213,21 @@ static int str_gsub (lua_State *L) {
   while (n < max_s) {
     const char *e;
     ms.level = 0;
-    e = match(&ms, src, p);
+    e = domatch(&ms, pt, src, p);
     if (e) {
       n++;
       add_value(&ms, &b, src, e);
     }
     if (e && e>src) /* non empty match? */
       src = e;  /* skip it */
-    else if (src < ms.src_end)
-      luaL_addchar(&b, *src++);
+    else if (src < ms.src_end) {
+      if (pt && !anchor) {  /* copy everything up to the next candidate */
+        const char *next = pskip(pt, src+1, ms.src_end);
+        luaL_addlstring(&b, src, next-src);
+        src = next;
+      }
+      else luaL_addchar(&b, *src++);
+    }
     else break;
     if (anchor) break;
   }
@@ -856,7 +1415,20 @@ static void createmetatable (lua_State *L) {
 /*
 ** Open string library
 */
+static void createcache (lua_State *L) {
+  lua_newtable(L);  /* compiled patterns, by pattern string */
+  lua_createtable(L, 0, 1);
+  lua_pushliteral(L, "v");
+  lua_setfield(L, -2, "__mode");  /* programs are collectable */
+  lua_setmetatable(L, -2);
+  lua_pushvalue(L, -1);
+  lua_setfield(L, LUA_REGISTRYINDEX, LUA_PATTERNCACHE);
+}
+
+
 LUALIB_API int luaopen_string (lua_State *L) {
+  createcache(L);
+  lua_replace(L, LUA_ENVIRONINDEX);
   luaL_register(L, LUA_STRLIBNAME, strlib);
 #if defined(LUA_COMPAT_GFIND)
   lua_getfield(L, -1, "gmatch");
@@ -33,6 +33,7 @@
 #include "lobject.h"
 #include "lstate.h"
 #include "ltable.h"
+#include "ltm.h"
 
 
 /*
@@ -359,7 +360,7 @@ Table *luaH_new (lua_State *L, int narray, int nhash) {
   Table *t = luaM_new(L, Table);
   luaC_link(L, obj2gco(t), LUA_TTABLE);
   t->metatable = NULL;
-  t->flags = cast_byte(~0);
+  t->flags = cast_byte(~(1u<<TM_CHAINBIT));  /* no TMs; in no chain */
   /* temporary values (kept only if some malloc fails) */
   t->array = NULL;
   t->sizearray = 0;
@@ -379,6 +380,27 @@ void luaH_free (lua_State *L, Table *t) {
 }
 
 
+/*
+** empties table `t' in place, keeping the storage of both parts; only
+** references are dropped, so no GC barrier is needed
+*/
+void luaH_clear (Table *t) {
+  int i;
+  for (i = 0; i < t->sizearray; i++)
+    setnilvalue(&t->array[i]);
+  if (t->node != dummynode) {
+    int size = sizenode(t);
+    for (i = 0; i < size; i++) {
+      Node *n = gnode(t, i);
+      gnext(n) = NULL;
+      setnilvalue(gkey(n));
+      setnilvalue(gval(n));
+    }
+    t->lastfree = gnode(t, size);  /* all positions are free again */
+  }
+}
+
+
 static Node *getfreepos (Table *t) {
   while (t->lastfree-- > t->node) {
     if (ttisnil(gkey(t->lastfree)))
@@ -463,6 +485,23 @@ const TValue *luaH_getstr (Table *t, TString *key) {
 }
 
 
+/*
+** search function for strings that also stores in `pos' the node where
+** the key was found (for the inline caches of the VM)
+*/
+const TValue *luaH_getstrnode (Table *t, TString *key, int *pos) {
+  Node *n = hashstr(t, key);
+  do {
+    if (ttisstring(gkey(n)) && rawtsvalue(gkey(n)) == key) {
+      *pos = cast_int(n - t->node);
+      return gval(n);
+    }
+    else n = gnext(n);
+  } while (n);
+  return luaO_nilobject;
+}
+
+
 /*
 ** main search function
 */
@@ -493,6 +532,7 @@ const TValue *luaH_get (Table *t, const TValue *key) {
 
 TValue *luaH_set (lua_State *L, Table *t, const TValue *key) {
   const TValue *p = luaH_get(t, key);
+  luaT_chaincheck(L, t);
   t->flags = 0;
   if (p != luaO_nilobject)
     return cast(TValue *, p);
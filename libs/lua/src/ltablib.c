@@ -5,7 +5,9 @@
 */
 
 
+#include <limits.h>
 #include <stddef.h>
+#include <string.h>
 
 #define ltablib_c
 #define LUA_LIB
@@ -115,6 +117,24 @@ static int tinsert (lua_State *L) {
 }
 
 
+static int tnew (lua_State *L) {
+  lua_Number narr = luaL_optnumber(L, 1, 0);  /* array part size */
+  lua_Number nrec = luaL_optnumber(L, 2, 0);  /* hash part size */
+  /* check before converting, which would truncate large sizes */
+  luaL_argcheck(L, 0 <= narr && narr <= INT_MAX, 1, "size out of range");
+  luaL_argcheck(L, 0 <= nrec && nrec <= INT_MAX, 2, "size out of range");
+  lua_createtable(L, (int)narr, (int)nrec);
+  return 1;
+}
+
+
+static int tclear (lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_cleartable(L, 1);  /* keeps the allocated array and hash parts */
+  return 0;
+}
+
+
 static int tremove (lua_State *L) {
   int e = aux_getn(L, 1);
   int pos = luaL_optint(L, 2, e);
@@ -132,6 +152,64 @@ static int tremove (lua_State *L) {
 }
 
 
+/*
+** concat of strings only. Pieces are copied while they fit into the
+** buffer; past that only their lengths are added up, and the buffer grows
+** once to the exact size of the rest.
+*/
+static int concatstrings (luaL_Buffer *b, const char *sep, size_t lsep,
+                                          int i, int last) {
+  lua_State *L = b->L;
+  size_t len = 0;  /* result length */
+  size_t n = 0;  /* bytes in the buffer */
+  int rest = last + 1;  /* first element not in the buffer */
+  int k;
+  char *p;
+  for (k = i; k <= last; k++) {
+    size_t l;
+    const char *s;
+    size_t lpiece;
+    lua_rawgeti(L, 1, k);
+    if (lua_type(L, -1) != LUA_TSTRING) {  /* numbers need conversion */
+      lua_pop(L, 1);
+      return 0;
+    }
+    s = lua_tolstring(L, -1, &l);
+    lpiece = (k != last) ? l + lsep : l;
+    if (rest > last) {  /* still copying? */
+      if (lpiece <= LUAL_BUFFERSIZE - n) {
+        luaL_addlstring(b, s, l);
+        luaL_addlstring(b, sep, lpiece - l);
+        n += lpiece;
+      }
+      else
+        rest = k;
+    }
+    len += lpiece;
+    lua_pop(L, 1);  /* string is still referenced by the table */
+  }
+  if (rest <= last) {
+    p = luaL_prepbuffsize(b, len - n);
+    for (k = rest; k <= last; k++) {
+      size_t l;
+      const char *s;
+      lua_rawgeti(L, 1, k);
+      s = lua_tolstring(L, -1, &l);
+      memcpy(p, s, l);
+      p += l;
+      lua_pop(L, 1);
+      if (k != last) {
+        memcpy(p, sep, lsep);
+        p += lsep;
+      }
+    }
+    luaL_addsize(b, len - n);
+  }
+  luaL_pushresult(b);
+  return 1;
+}
+
+
 static int tconcat (lua_State *L) {
   luaL_Buffer b;
   size_t lsep;
@@ -141,6 +219,9 @@ static int tconcat (lua_State *L) {
   i = luaL_optint(L, 3, 1);
   last = luaL_opt(L, luaL_checkint, 4, luaL_getn(L, 1));
   luaL_buffinit(L, &b);
+  if (concatstrings(&b, sep, lsep, i, last))
+    return 1;
+  luaL_buffinit(L, &b);  /* drop the pieces copied so far */
   for (; i <= last; i++) {
     lua_rawgeti(L, 1, i);
     luaL_argcheck(L, lua_isstring(L, -1), 1, "table contains non-strings");
@@ -159,9 +240,15 @@ static int tconcat (lua_State *L) {
 ** Quicksort
 ** (based on `Algorithms in MODULA-3', Robert Sedgewick;
 **  Addison-Wesley, 1993.)
+** Introsort variant: ranges shorter than SORT_CUTOFF are left to
+** insertion sort, and ranges that recurse too deep fall back to heapsort
 */
 
 
+#define SORT_CUTOFF	8	/* ranges shorter than this use insertion sort */
+#define MERGE_RUN	8	/* stablesort merges runs of at least this size */
+
+
 static void set2 (lua_State *L, int i, int j) {
   lua_rawseti(L, 1, i);
   lua_rawseti(L, 1, j);
@@ -182,9 +269,78 @@ static int sort_comp (lua_State *L, int a, int b) {
     return lua_lessthan(L, a, b);
 }
 
-static void auxsort (lua_State *L, int l, int u) {
-  while (l < u) {  /* for tail recursion */
+static int sort_depth (int n) {  /* 2*log2(n) partitions before heapsort */
+  int d = 0;
+  while (n > 1) {
+    n >>= 1;
+    d += 2;
+  }
+  return d;
+}
+
+/* stable, and safe with inconsistent order functions */
+static void insertsort (lua_State *L, int l, int u) {
+  int i, j;
+  for (i = l+1; i <= u; i++) {
+    lua_rawgeti(L, 1, i);  /* element to insert */
+    for (j = i-1; j >= l; j--) {
+      lua_rawgeti(L, 1, j);
+      if (!sort_comp(L, -2, -1)) {  /* not a[i] < a[j]? */
+        lua_pop(L, 1);
+        break;
+      }
+      lua_rawseti(L, 1, j+1);  /* move a[j] up */
+    }
+    lua_rawseti(L, 1, j+1);
+  }
+}
+
+/* sift a[l+i] down the heap of n elements starting at a[l] */
+static void siftdown (lua_State *L, int l, int i, int n) {
+  lua_rawgeti(L, 1, l+i);
+  for (;;) {
+    int c = 2*i + 1;  /* first child */
+    if (c >= n) break;
+    lua_rawgeti(L, 1, l+c);
+    if (c+1 < n) {
+      lua_rawgeti(L, 1, l+c+1);
+      if (sort_comp(L, -2, -1)) {  /* a[c] < a[c+1]? */
+        lua_remove(L, -2);
+        c++;
+      }
+      else
+        lua_pop(L, 1);
+    }
+    if (!sort_comp(L, -2, -1)) {  /* not v < a[c]? */
+      lua_pop(L, 1);
+      break;
+    }
+    lua_rawseti(L, 1, l+i);  /* a[i] = a[c] */
+    i = c;
+  }
+  lua_rawseti(L, 1, l+i);
+}
+
+static void heapsort (lua_State *L, int l, int u) {
+  int n = u-l+1;
+  int i;
+  for (i = n/2 - 1; i >= 0; i--)
+    siftdown(L, l, i, n);
+  for (i = n-1; i > 0; i--) {
+    lua_rawgeti(L, 1, l);
+    lua_rawgeti(L, 1, l+i);
+    set2(L, l, l+i);  /* move the maximum behind the heap */
+    siftdown(L, l, 0, i);
+  }
+}
+
+static void auxsort (lua_State *L, int l, int u, int depth) {
+  while (u-l >= SORT_CUTOFF) {  /* for tail recursion */
     int i, j;
+    if (depth-- == 0) {  /* degenerate partitions? */
+      heapsort(L, l, u);
+      return;
+    }
     /* sort elements a[l], a[(l+u)/2] and a[u] */
     lua_rawgeti(L, 1, l);
     lua_rawgeti(L, 1, u);
@@ -192,8 +348,7 @@ static void auxsort (lua_State *L, int l, int u) {
       set2(L, l, u);  /* swap a[l] - a[u] */
     else
       lua_pop(L, 2);
-    if (u-l == 1) break;  /* only 2 elements */
-    i = (l+u)/2;
+    i = l+(u-l)/2;
     lua_rawgeti(L, 1, i);
     lua_rawgeti(L, 1, l);
     if (sort_comp(L, -2, -1))  /* a[i]<a[l]? */
@@ -206,7 +361,6 @@ static void auxsort (lua_State *L, int l, int u) {
       else
         lua_pop(L, 2);
     }
-    if (u-l == 2) break;  /* only 3 elements */
     lua_rawgeti(L, 1, i);  /* Pivot */
     lua_pushvalue(L, -1);
     lua_rawgeti(L, 1, u-1);
@@ -241,8 +395,352 @@ static void auxsort (lua_State *L, int l, int u) {
     else {
       j=i+1; i=u; u=j-2;
     }
-    auxsort(L, j, i);  /* call recursively the smaller one */
+    auxsort(L, j, i, depth);  /* call recursively the smaller one */
   }  /* repeat the routine for the larger one */
+  insertsort(L, l, u);
+}
+
+
+/*
+** Without an order function, arrays holding only numbers or only strings
+** are sorted in C on a copy of their keys; the values themselves are
+** moved through the API once, at the end.
+*/
+
+typedef struct SortItem {
+  union {
+    lua_Number n;
+    struct {
+      const char *s;
+      size_t l;
+    } str;
+  } u;
+  int i;  /* original position of the value */
+} SortItem;
+
+typedef struct SortState {
+  SortItem *a;
+  int isstr;  /* comparing strings (or numbers)? */
+  int stable;  /* order equal keys by original position? */
+} SortState;
+
+
+/* same order as `lua_lessthan' on strings */
+static int item_strcmp (const SortItem *a, const SortItem *b) {
+  const char *l = a->u.str.s;
+  size_t ll = a->u.str.l;
+  const char *r = b->u.str.s;
+  size_t lr = b->u.str.l;
+  for (;;) {
+    int temp = strcoll(l, r);
+    if (temp != 0) return temp;
+    else {  /* strings are equal up to a `\0' */
+      size_t len = strlen(l);  /* index of first `\0' in both strings */
+      if (len == lr)  /* r is finished? */
+        return (len == ll) ? 0 : 1;
+      else if (len == ll)  /* l is finished? */
+        return -1;  /* l is smaller than r (because r is not finished) */
+      /* both strings longer than `len'; go on comparing (after the `\0') */
+      len++;
+      l += len; ll -= len; r += len; lr -= len;
+    }
+  }
+}
+
+static int item_lt (const SortState *ss, const SortItem *a,
+                                         const SortItem *b) {
+  int c;
+  if (ss->isstr)
+    c = item_strcmp(a, b);
+  else
+    c = (a->u.n < b->u.n) ? -1 : (b->u.n < a->u.n);
+  if (c == 0 && ss->stable)
+    return a->i < b->i;
+  return c < 0;
+}
+
+static void swapitems (SortItem *a, int i, int j) {
+  SortItem t = a[i];
+  a[i] = a[j];
+  a[j] = t;
+}
+
+static void item_insertsort (const SortState *ss, int l, int u) {
+  SortItem *a = ss->a;
+  int i, j;
+  for (i = l+1; i <= u; i++) {
+    SortItem v = a[i];
+    for (j = i-1; j >= l && item_lt(ss, &v, &a[j]); j--)
+      a[j+1] = a[j];
+    a[j+1] = v;
+  }
+}
+
+static void item_siftdown (const SortState *ss, int l, int i, int n) {
+  SortItem *a = ss->a + l;
+  SortItem v = a[i];
+  for (;;) {
+    int c = 2*i + 1;
+    if (c >= n) break;
+    if (c+1 < n && item_lt(ss, &a[c], &a[c+1])) c++;
+    if (!item_lt(ss, &v, &a[c])) break;
+    a[i] = a[c];
+    i = c;
+  }
+  a[i] = v;
+}
+
+static void item_heapsort (const SortState *ss, int l, int u) {
+  int n = u-l+1;
+  int i;
+  for (i = n/2 - 1; i >= 0; i--)
+    item_siftdown(ss, l, i, n);
+  for (i = n-1; i > 0; i--) {
+    swapitems(ss->a, l, l+i);
+    item_siftdown(ss, l, 0, i);
+  }
+}
+
+static void item_sort (const SortState *ss, int l, int u, int depth) {
+  SortItem *a = ss->a;
+  while (u-l >= SORT_CUTOFF) {
+    SortItem p;
+    int i, j;
+    if (depth-- == 0) {
+      item_heapsort(ss, l, u);
+      return;
+    }
+    i = l+(u-l)/2;  /* median of three, leaving a[l] <= a[i] <= a[u] */
+    if (item_lt(ss, &a[u], &a[l])) swapitems(a, l, u);
+    if (item_lt(ss, &a[i], &a[l])) swapitems(a, i, l);
+    else if (item_lt(ss, &a[u], &a[i])) swapitems(a, i, u);
+    swapitems(a, i, u-1);
+    p = a[u-1];
+    /* keys are totally ordered, so a[l] and a[u-1] stop both scans */
+    i = l; j = u-1;
+    for (;;) {
+      while (item_lt(ss, &a[++i], &p)) {}
+      while (item_lt(ss, &p, &a[--j])) {}
+      if (j < i) break;
+      swapitems(a, i, j);
+    }
+    swapitems(a, u-1, i);
+    if (i-l < u-i) {
+      item_sort(ss, l, i-1, depth);
+      l = i+1;
+    }
+    else {
+      item_sort(ss, i+1, u, depth);
+      u = i-1;
+    }
+  }
+  item_insertsort(ss, l, u);
+}
+
+/* move every value to its sorted position, one permutation cycle at a time */
+static void item_permute (lua_State *L, SortItem *a, int n) {
+  int s;
+  for (s = 0; s < n; s++) {
+    int j = s;
+    if (a[s].i == s+1) continue;  /* already in place */
+    lua_rawgeti(L, 1, s+1);  /* first value overwritten in this cycle */
+    for (;;) {
+      int k = a[j].i;  /* position j+1 receives the value at k */
+      a[j].i = j+1;  /* mark as done */
+      if (k == s+1) break;
+      lua_rawgeti(L, 1, k);
+      lua_rawseti(L, 1, j+1);
+      j = k-1;
+    }
+    lua_rawseti(L, 1, j+1);
+  }
+}
+
+static int itemsort (lua_State *L, int n, int isstr, int stable) {
+  SortState ss;
+  int i;
+  ss.a = (SortItem *)lua_newuserdata(L, n * sizeof(SortItem));
+  ss.isstr = isstr;
+  ss.stable = stable;
+  for (i = 0; i < n; i++) {
+    SortItem *it = &ss.a[i];
+    lua_rawgeti(L, 1, i+1);
+    if (lua_type(L, -1) != (isstr ? LUA_TSTRING : LUA_TNUMBER)) {
+      lua_pop(L, 2);  /* mixed types */
+      return 0;
+    }
+    if (isstr)
+      it->u.str.s = lua_tolstring(L, -1, &it->u.str.l);
+    else {
+      it->u.n = lua_tonumber(L, -1);
+      if (it->u.n != it->u.n) {  /* NaN has no order */
+        lua_pop(L, 2);
+        return 0;
+      }
+    }
+    it->i = i+1;
+    lua_pop(L, 1);  /* strings stay referenced by the table */
+  }
+  item_sort(&ss, 0, n-1, sort_depth(n));
+  item_permute(L, ss.a, n);
+  lua_pop(L, 1);  /* item array */
+  return 1;
+}
+
+
+static void swapnums (lua_Number *a, int i, int j) {
+  lua_Number t = a[i];
+  a[i] = a[j];
+  a[j] = t;
+}
+
+static void num_insertsort (lua_Number *a, int l, int u) {
+  int i, j;
+  for (i = l+1; i <= u; i++) {
+    lua_Number v = a[i];
+    for (j = i-1; j >= l && v < a[j]; j--)
+      a[j+1] = a[j];
+    a[j+1] = v;
+  }
+}
+
+static void num_siftdown (lua_Number *a, int i, int n) {
+  lua_Number v = a[i];
+  for (;;) {
+    int c = 2*i + 1;
+    if (c >= n) break;
+    if (c+1 < n && a[c] < a[c+1]) c++;
+    if (!(v < a[c])) break;
+    a[i] = a[c];
+    i = c;
+  }
+  a[i] = v;
+}
+
+static void num_sort (lua_Number *a, int l, int u, int depth) {
+  while (u-l >= SORT_CUTOFF) {
+    lua_Number p;
+    int i, j;
+    if (depth-- == 0) {  /* heapsort a[l..u] */
+      int n = u-l+1;
+      for (i = n/2 - 1; i >= 0; i--)
+        num_siftdown(a+l, i, n);
+      for (i = n-1; i > 0; i--) {
+        swapnums(a, l, l+i);
+        num_siftdown(a+l, 0, i);
+      }
+      return;
+    }
+    i = l+(u-l)/2;
+    if (a[u] < a[l]) swapnums(a, l, u);
+    if (a[i] < a[l]) swapnums(a, i, l);
+    else if (a[u] < a[i]) swapnums(a, i, u);
+    swapnums(a, i, u-1);
+    p = a[u-1];
+    i = l; j = u-1;
+    for (;;) {
+      while (a[++i] < p) {}
+      while (p < a[--j]) {}
+      if (j < i) break;
+      swapnums(a, i, j);
+    }
+    swapnums(a, u-1, i);
+    if (i-l < u-i) {
+      num_sort(a, l, i-1, depth);
+      l = i+1;
+    }
+    else {
+      num_sort(a, i+1, u, depth);
+      u = i-1;
+    }
+  }
+  num_insertsort(a, l, u);
+}
+
+/* numbers are written back by value; only stablesort must keep -0 and 0 */
+static int numsort (lua_State *L, int n) {
+  lua_Number *a = (lua_Number *)lua_newuserdata(L, n * sizeof(lua_Number));
+  int i;
+  for (i = 0; i < n; i++) {
+    lua_rawgeti(L, 1, i+1);
+    a[i] = lua_tonumber(L, -1);
+    if (lua_type(L, -1) != LUA_TNUMBER || a[i] != a[i]) {  /* NaN? */
+      lua_pop(L, 2);
+      return 0;
+    }
+    lua_pop(L, 1);
+  }
+  num_sort(a, 0, n-1, sort_depth(n));
+  for (i = 0; i < n; i++) {
+    lua_pushnumber(L, a[i]);
+    lua_rawseti(L, 1, i+1);
+  }
+  lua_pop(L, 1);  /* number array */
+  return 1;
+}
+
+static int fastsort (lua_State *L, int n, int stable) {
+  int t;
+  if (!lua_isnil(L, 2) || n < 2 ||
+      (size_t)n > ((size_t)~0) / sizeof(SortItem))
+    return 0;
+  lua_rawgeti(L, 1, 1);
+  t = lua_type(L, -1);
+  lua_pop(L, 1);
+  if (t == LUA_TNUMBER && !stable)
+    return numsort(L, n);
+  else if (t == LUA_TNUMBER || t == LUA_TSTRING)
+    return itemsort(L, n, t == LUA_TSTRING, stable);
+  else
+    return 0;
+}
+
+
+static void mergeruns (lua_State *L, int src, int dst, int l, int m, int u) {
+  int i = l, j = m+1, k;
+  for (k = l; k <= u; k++) {  /* merge src[l..m] and src[m+1..u] */
+    if (i > m)
+      lua_rawgeti(L, src, j++);
+    else if (j > u)
+      lua_rawgeti(L, src, i++);
+    else {
+      lua_rawgeti(L, src, i);
+      lua_rawgeti(L, src, j);
+      if (sort_comp(L, -1, -2)) {  /* src[j] < src[i]? */
+        lua_remove(L, -2);
+        j++;
+      }
+      else {  /* ties take the left element */
+        lua_pop(L, 1);
+        i++;
+      }
+    }
+    lua_rawseti(L, dst, k);
+  }
+}
+
+static void mergesort (lua_State *L, int n) {
+  int src = 1, dst = 3;
+  int w, l;
+  for (l = 1; l <= n; l += MERGE_RUN)
+    insertsort(L, l, (n-l < MERGE_RUN) ? n : l+MERGE_RUN-1);
+  if (n <= MERGE_RUN) return;
+  lua_createtable(L, n, 0);  /* merge buffer at index 3 */
+  for (w = MERGE_RUN; w < n; w *= 2) {
+    for (l = 1; l <= n; l += 2*w) {
+      int m = (n-l < w) ? n : l+w-1;
+      int u = (n-l < 2*w) ? n : l+2*w-1;
+      mergeruns(L, src, dst, l, m, u);
+    }
+    src = dst; dst = 4-dst;  /* swap roles of table and buffer */
+  }
+  if (src != 1) {
+    for (l = 1; l <= n; l++) {
+      lua_rawgeti(L, 3, l);
+      lua_rawseti(L, 1, l);
+    }
+  }
+  lua_pop(L, 1);
 }
 
 static int sort (lua_State *L) {
@@ -251,7 +749,19 @@ static int sort (lua_State *L) {
   if (!lua_isnoneornil(L, 2))  /* is there a 2nd argument? */
     luaL_checktype(L, 2, LUA_TFUNCTION);
   lua_settop(L, 2);  /* make sure there is two arguments */
-  auxsort(L, 1, n);
+  if (!fastsort(L, n, 0))
+    auxsort(L, 1, n, sort_depth(n));
+  return 0;
+}
+
+static int stablesort (lua_State *L) {
+  int n = aux_getn(L, 1);
+  luaL_checkstack(L, 40, "");
+  if (!lua_isnoneornil(L, 2))
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+  lua_settop(L, 2);
+  if (!fastsort(L, n, 1))
+    mergesort(L, n);
   return 0;
 }
 
@@ -259,15 +769,18 @@ static int sort (lua_State *L) {
 
 
 static const luaL_Reg tab_funcs[] = {
+  {"clear", tclear},
   {"concat", tconcat},
   {"foreach", foreach},
   {"foreachi", foreachi},
   {"getn", getn},
   {"maxn", maxn},
   {"insert", tinsert},
+  {"new", tnew},
   {"remove", tremove},
   {"setn", setn},
   {"sort", sort},
+  {"stablesort", stablesort},
   {NULL, NULL}
 };
 
@@ -73,3 +73,65 @@ const TValue *luaT_gettmbyobj (lua_State *L, const TValue *o, TMS event) {
   return (mt ? luaH_getstr(mt, G(L)->tmname[event]) : luaO_nilobject);
 }
 
+
+
+/*
+** {======================================================
+** Cache of resolved `__index' chains
+** =======================================================
+*/
+
+#define MAXCHAIN	100  /* same limit as `MAXTAGLOOP' */
+
+
+/*
+** value of string `key' in an object with metatable `mt' and no such
+** field of its own, following the chain of `__index' tables. Returns
+** NULL when the chain ends in something else than a table (usually an
+** `__index' function), which the caller must handle.
+*/
+const TValue *luaT_chainget (lua_State *L, Table *mt, TString *key) {
+  global_State *g = G(L);
+  ChainEntry *e = &g->chaincache[lmod(IntPoint(mt) ^ key->tsv.hash,
+                                      LUAI_CHAINCACHE)];
+  const TValue *res = luaO_nilobject;
+  Table *h = mt;
+  int loop;
+  if (e->mt == mt && e->key == key && e->epoch == g->chainepoch)
+    return &e->val;  /* hit */
+  for (loop = 0; loop < MAXCHAIN; loop++) {
+    const TValue *tm;
+    h->flags |= cast_byte(1u<<TM_CHAINBIT);  /* changes to `h' matter */
+    tm = fasttm(L, h, TM_INDEX);
+    if (tm == NULL) break;  /* end of chain: `key' is absent */
+    if (!ttistable(tm)) return NULL;
+    h = hvalue(tm);
+    h->flags |= cast_byte(1u<<TM_CHAINBIT);
+    res = luaH_getstr(h, key);
+    if (!ttisnil(res) || (h = h->metatable) == NULL) break;
+  }
+  if (loop == MAXCHAIN) return NULL;  /* let the caller report the loop */
+  e->mt = mt;
+  e->key = key;
+  setobj(L, &e->val, res);
+  e->epoch = g->chainepoch;
+  return &e->val;
+}
+
+
+/*
+** called when some table that is part of a cached chain changes its
+** contents or its metatable, and by the collector (which may reuse the
+** memory of dead tables and strings)
+*/
+void luaT_chainchanged (lua_State *L) {
+  global_State *g = G(L);
+  if (++g->chainepoch == 0) {  /* wrapped around? */
+    int i;
+    for (i = 0; i < LUAI_CHAINCACHE; i++)
+      g->chaincache[i].epoch = 0;
+    g->chainepoch = 1;
+  }
+}
+
+/* }====================================================== */
@@ -43,12 +43,27 @@ typedef enum {
 
 #define fasttm(l,et,e)	gfasttm(G(l), et, e)
 
+/*
+** bit of `flags' marking tables that are part of some cached `__index'
+** chain (either as metatables or as `__index' tables)
+*/
+#define TM_CHAINBIT	7
+
+#define inchain(t)	((t)->flags & (1u<<TM_CHAINBIT))
+
+/* invalidates the chain cache if table `t' is part of some chain */
+#define luaT_chaincheck(L,t) \
+	{ if (inchain(t)) luaT_chainchanged(L); }
+
 LUAI_DATA const char *const luaT_typenames[];
 
 
 LUAI_FUNC const TValue *luaT_gettm (Table *events, TMS event, TString *ename);
 LUAI_FUNC const TValue *luaT_gettmbyobj (lua_State *L, const TValue *o,
                                                        TMS event);
+LUAI_FUNC const TValue *luaT_chainget (lua_State *L, Table *mt,
+                                                     TString *key);
+LUAI_FUNC void luaT_chainchanged (lua_State *L);
 LUAI_FUNC void luaT_init (lua_State *L);
 
 #endif
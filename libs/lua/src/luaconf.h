@@ -71,6 +71,20 @@
 #define LUA_INIT	"LUA_INIT"
 
 
+/*
+@@ LUA_BCCACHE is the name of the environment variable that names a
+@* directory where luaL_loadfile keeps precompiled chunks.
+** CHANGE it if you want a different name, or undefine it to leave the
+** cache out. It needs `stat' and `mkstemp', so it is on only in POSIX
+** builds (and only for processes that set the variable). The directory
+** must be writable only by its user: its contents are loaded as trusted
+** bytecode.
+*/
+#if defined(LUA_USE_POSIX)
+#define LUA_BCCACHE	"LUA_BCCACHE"
+#endif
+
+
 /*
 @@ LUA_PATH_DEFAULT is the default path that Lua uses to look for
 @* Lua libraries.
@@ -292,6 +306,41 @@
 /* }================================================================== */
 
 
+/*
+@@ LUA_FULLHASH makes the string table hash every char of a string.
+** CHANGE it (define it) if your program interns many long strings that
+** differ only in a few chars, or strings that come from untrusted input.
+** By default Lua hashes at most 32 chars of each string, so such strings
+** may all fall in the same chain. The full hash reads the string a word
+** at a time and mixes in a random seed chosen for each new state, so
+** colliding strings cannot be precomputed.
+*/
+/* #define LUA_FULLHASH */
+
+
+/*
+@@ LUA_USE_JUMPTABLE makes the interpreter dispatch instructions through
+@* a table of label addresses instead of a switch.
+** CHANGE it (define it) if your compiler supports labels as values (gcc,
+** clang); it is ignored by other compilers, which keep the switch.
+*/
+/* #define LUA_USE_JUMPTABLE */
+#if defined(LUA_USE_JUMPTABLE) && !defined(__GNUC__)
+#undef LUA_USE_JUMPTABLE
+#endif
+
+
+/*
+@@ luai_makeseed gives the random part of the seed for a new state.
+** CHANGE it if you have a better source of randomness. Lua also mixes in
+** the addresses of some objects, which vary with ASLR.
+*/
+#if defined(LUA_FULLHASH)
+#include <time.h>
+#define luai_makeseed()		((unsigned int)time(NULL))
+#endif
+
+
 /*
 @@ LUAI_GCPAUSE defines the default pause between garbage-collector cycles
 @* as a percentage.
@@ -313,6 +362,43 @@
 #define LUAI_GCMUL	200 /* GC runs 'twice the speed' of memory allocation */
 
 
+/*
+@@ LUAI_GCMAJOR defines, for the generational mode, how much memory in use
+@* may grow over its size after the last major collection (as a percentage)
+@* before the collector does a major collection instead of a minor one.
+** CHANGE it if your old data changes often (lower values) or is mostly
+** static (higher values). You can also change this value dynamically.
+*/
+#define LUAI_GCMAJOR	200  /* major GC when old data doubles */
+
+
+/*
+@@ LUAI_CHAINCACHE is the number of entries in the cache of resolved
+@* `__index' chains (must be a power of 2).
+** CHANGE it if your programs use many classes and fields through deep
+** inheritance (higher values) or if memory per state is scarce.
+*/
+#define LUAI_CHAINCACHE	128
+
+
+/*
+@@ luai_gcclock stores in `t' a time stamp, in seconds, used to time the
+@* work of the garbage collector (see collectgarbage("stats")).
+** CHANGE it if you have a cheaper or more precise clock. By default Lua
+** uses the monotonic clock when POSIX has it, and `clock' otherwise.
+*/
+#if defined(lgc_c) || defined(luaall_c)
+#include <time.h>
+#if defined(LUA_USE_POSIX) && defined(CLOCK_MONOTONIC)
+#define luai_gcclock(t)	{ struct timespec ts_; \
+	clock_gettime(CLOCK_MONOTONIC, &ts_); \
+	(t) = (lua_Number)ts_.tv_sec + (lua_Number)ts_.tv_nsec / 1e9; }
+#else
+#define luai_gcclock(t)	((t) = (lua_Number)clock() / CLOCKS_PER_SEC)
+#endif
+#endif
+
+
 
 /*
 @@ LUA_COMPAT_GETN controls compatibility with old getn behavior.
@@ -484,6 +570,8 @@
 
 /*
 @@ LUAL_BUFFERSIZE is the buffer size used by the lauxlib buffer system.
+** Larger contents move into one block that grows by doubling, allocated
+** with the state's lua_Alloc.
 */
 #define LUAL_BUFFERSIZE		BUFSIZ
 
@@ -14,6 +14,9 @@
 /* Key to file-handle type */
 #define LUA_FILEHANDLE		"FILE*"
 
+/* Key to the string library cache of compiled patterns */
+#define LUA_PATTERNCACHE	"_PATTERNS"
+
 
 #define LUA_COLIBNAME	"coroutine"
 LUALIB_API int (luaopen_base) (lua_State *L);
@@ -116,12 +116,15 @@ static void PrintCode(const Proto* f)
     printf("\t; %s",svalue(&f->k[bx]));
     break;
    case OP_GETTABLE:
+   case OP_GETFIELD:
    case OP_SELF:
     if (ISK(c)) { printf("\t; "); PrintConstant(f,INDEXK(c)); }
     break;
    case OP_SETTABLE:
    case OP_ADD:
    case OP_SUB:
+   case OP_ADDK:
+   case OP_SUBK:
    case OP_MUL:
    case OP_DIV:
    case OP_POW:
@@ -0,0 +1,74 @@
+-- bytecode cache of loadfile (LUA_BCCACHE): runs a loader twice over the
+-- same source and checks hits, changed sources and broken entries
+-- typical usage: lua bccache.lua (needs a POSIX shell)
+
+local lua = arg[-1]
+local dir = os.tmpname()
+os.remove(dir)
+assert(os.execute("mkdir -p " .. dir .. "/cache") == 0)
+local src, out, cache = dir .. "/src.lua", dir .. "/out", dir .. "/cache"
+
+local function readfile (name)
+  local f = assert(io.open(name, "rb"))
+  local s = f:read("*a")
+  f:close()
+  return s
+end
+
+local function writefile (name, s)
+  local f = assert(io.open(name, "wb"))
+  f:write(s)
+  f:close()
+end
+
+-- the loader prints what the chunk returns, or the load error
+writefile(dir .. "/loader.lua", [[
+local f, err = loadfile(arg[1])
+local o = io.open(arg[2], "w")
+o:write(f and tostring(f()) or err)
+o:close()
+]])
+
+local function run (cachedir)
+  assert(os.execute(("LUA_BCCACHE='%s' '%s' '%s/loader.lua' '%s' '%s'")
+                    :format(cachedir, lua, dir, src, out)) == 0)
+  return readfile(out)
+end
+
+-- inode and name of the cache entries, which change when rewritten
+local function entries ()
+  local p = io.popen("ls -i " .. cache)
+  local s = p:read("*a")
+  p:close()
+  return s
+end
+
+local function setsource (s)
+  writefile(src, s)
+  os.execute(("touch -r '%s/loader.lua' '%s'"):format(dir, src))  -- same mtime
+end
+
+-- miss, then hit
+setsource("return 'one'")
+assert(run(cache) == "one")
+local e = entries()
+local entry = cache .. "/" .. assert(e:match("%d+%s+(%S+)"))
+assert(run(cache) == "one" and entries() == e, "cache entry not reused")
+
+-- same size and mtime, other contents
+setsource("return 'two'")
+assert(run(cache) == "two" and entries() ~= e)
+
+-- truncated entry: recompiled and stored again
+local full = readfile(entry)
+writefile(entry, full:sub(1, 40))
+assert(run(cache) == "two")
+assert(readfile(entry) == full)
+
+-- syntax errors are reported as without the cache
+setsource("return 'two' +")
+local err = run(cache)
+assert(err:find("unexpected symbol") and err == run(""))
+
+os.execute("rm -rf " .. dir)
+print("bccache ok")
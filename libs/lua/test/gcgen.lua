@@ -0,0 +1,32 @@
+-- generational collector with a small pause: collectgarbage("step") must
+-- run one collection and return, and allocation must not collect each time
+
+local collections = 0         -- counted by a garbage proxy renewed on each
+local function sentinel ()
+  local p = newproxy(true)
+  getmetatable(p).__gc = function () collections = collections + 1; sentinel() end
+end
+
+collectgarbage("generational")
+collectgarbage("setpause", 100)
+
+local keep = {}
+for i = 1, 20000 do keep[i] = { i } end
+
+sentinel()
+local before = collections
+for i = 1, 100 do
+  assert(collectgarbage("step") == true)
+end
+assert(collections - before >= 100)
+
+before = collections
+for i = 1, 200000 do local t = { i } end
+local minor = collections - before
+assert(minor < 2000, "a minor collection per allocation")
+
+collectgarbage("setpause", 50)
+assert(collectgarbage("step") == true)
+collectgarbage("incremental")
+collectgarbage("setpause", 200)
+print("gcgen", minor)
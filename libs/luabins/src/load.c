@@ -16,6 +16,7 @@ typedef struct lbs_LoadState
 {
   const unsigned char * pos;
   size_t unread;
+  int format; /* 1 or 2, see LUABINS_CFORMAT2 */
 } lbs_LoadState;
 
 static void lbsLS_init(
@@ -26,6 +27,7 @@ static void lbsLS_init(
 {
   ls->pos = (len > 0) ? data : NULL;
   ls->unread = len;
+  ls->format = 1;
 }
 
 #define lbsLS_good(ls) \
@@ -38,10 +40,15 @@ static unsigned char lbsLS_readbyte(lbs_LoadState * ls)
 {
   if (lbsLS_good(ls))
   {
-    const unsigned char b = *ls->pos;
-    ++ls->pos;
-    --ls->unread;
-    return b;
+    if (ls->unread > 0)
+    {
+      const unsigned char b = *ls->pos;
+      ++ls->pos;
+      --ls->unread;
+      return b;
+    }
+
+    ls->pos = NULL;
   }
   return 0;
 }
@@ -81,6 +88,63 @@ static int lbsLS_readbytes(
   return LUABINS_EBADDATA;
 }
 
+static int lbsLS_readvarint(lbs_LoadState * ls, size_t * value)
+{
+  size_t result = 0;
+  unsigned int shift = 0;
+  unsigned int i = 0;
+
+  for (i = 0; i < LUABINS_MAXVARINTLEN; ++i)
+  {
+    unsigned char b = lbsLS_readbyte(ls);
+    if (!lbsLS_good(ls))
+    {
+      return LUABINS_EBADDATA;
+    }
+
+    /* Bits that do not fit into size_t */
+    if (
+        shift > 0 &&
+        ((size_t)(b & 0x7F) >> (sizeof(size_t) * 8 - shift)) != 0
+      )
+    {
+      return LUABINS_EBADSIZE;
+    }
+
+    result |= (size_t)(b & 0x7F) << shift;
+    if ((b & 0x80) == 0)
+    {
+      *value = result;
+      return LUABINS_ESUCCESS;
+    }
+
+    shift += 7;
+  }
+
+  return LUABINS_EBADSIZE;
+}
+
+/* Reads table size, stored as int or as varint depending on format */
+static int lbsLS_readtablesize(lbs_LoadState * ls, int * size)
+{
+  size_t value = 0;
+  int result = LUABINS_ESUCCESS;
+
+  if (ls->format == 1)
+  {
+    return lbsLS_readbytes(ls, (unsigned char *)size, LUABINS_LINT);
+  }
+
+  result = lbsLS_readvarint(ls, &value);
+  if (result == LUABINS_ESUCCESS)
+  {
+    /* Out of range values are caught by size checks of load_table() */
+    *size = (value > (size_t)MAXASIZE) ? -1 : (int)value;
+  }
+
+  return result;
+}
+
 static int load_value(lua_State * L, lbs_LoadState * ls);
 
 static int load_table(lua_State * L, lbs_LoadState * ls)
@@ -89,10 +153,10 @@ static int load_table(lua_State * L, lbs_LoadState * ls)
   int hash_size = 0;
   unsigned int total_size = 0;
 
-  int result = lbsLS_readbytes(ls, (unsigned char *)&array_size, LUABINS_LINT);
+  int result = lbsLS_readtablesize(ls, &array_size);
   if (result == LUABINS_ESUCCESS)
   {
-    result = lbsLS_readbytes(ls, (unsigned char *)&hash_size, LUABINS_LINT);
+    result = lbsLS_readtablesize(ls, &hash_size);
   }
 
   if (result == LUABINS_ESUCCESS)
@@ -102,7 +166,10 @@ static int load_table(lua_State * L, lbs_LoadState * ls)
         array_size < 0 || array_size > MAXASIZE ||
         hash_size < 0  ||
         (hash_size > 0 && ceillog2((unsigned int)hash_size) > MAXBITS) ||
-        lbsLS_unread(ls) < luabins_min_table_data_size(total_size)
+        lbsLS_unread(ls) < luabins_min_table_data_size(
+            total_size,
+            (ls->format == 1) ? LUABINS_LMINLARGEVALUE : LUABINS_LMINLARGEVALUE2
+          )
       )
     {
       result = LUABINS_EBADSIZE;
@@ -192,10 +259,45 @@ static int load_value(lua_State * L, lbs_LoadState * ls)
     }
     break;
 
+  case LUABINS_CINTEGER:
+    {
+      size_t zigzag = 0;
+      if (ls->format == 1)
+      {
+        result = LUABINS_EBADDATA;
+        break;
+      }
+
+      result = lbsLS_readvarint(ls, &zigzag);
+      if (result == LUABINS_ESUCCESS)
+      {
+        if ((zigzag >> 1) > (size_t)LUABINS_MAXCOMPACTINT)
+        {
+          result = LUABINS_EBADDATA;
+        }
+        else if (zigzag & 1)
+        {
+          lua_pushnumber(L, (lua_Number)(-(long)(zigzag >> 1) - 1));
+        }
+        else
+        {
+          lua_pushnumber(L, (lua_Number)(long)(zigzag >> 1));
+        }
+      }
+    }
+    break;
+
   case LUABINS_CSTRING:
     {
       size_t len = 0;
-      result = lbsLS_readbytes(ls, (unsigned char *)&len, LUABINS_LSIZET);
+      if (ls->format == 1)
+      {
+        result = lbsLS_readbytes(ls, (unsigned char *)&len, LUABINS_LSIZET);
+      }
+      else
+      {
+        result = lbsLS_readvarint(ls, &len);
+      }
       if (result == LUABINS_ESUCCESS)
       {
         const unsigned char * pos = lbsLS_eat(ls, len);
@@ -240,6 +342,11 @@ int luabins_load(
 
   lbsLS_init(&ls, data, len);
   num_items = lbsLS_readbyte(&ls);
+  if (lbsLS_good(&ls) && num_items == LUABINS_CFORMAT2)
+  {
+    ls.format = 2;
+    num_items = lbsLS_readbyte(&ls);
+  }
   if (!lbsLS_good(&ls))
   {
     result = LUABINS_EBADDATA;
@@ -26,6 +26,22 @@
 */
 int luabins_save(lua_State * L, int index_from, int index_to);
 
+/*
+* Same as luabins_save(), but saved data is passed to writer
+* (see lua_dump()) instead of being pushed as a string.
+* Data may be passed in several chunks. Nothing is pushed on success.
+* If writer returns non-zero, save is aborted.
+* Returns non-zero on failure, pushes error message on the top
+* of the stack.
+*/
+int luabins_dump(
+    lua_State * L,
+    int index_from,
+    int index_to,
+    lua_Writer writer,
+    void * ud
+  );
+
 /*
 * Load Lua values from given byte chunk.
 * Returns 0 on success, pushes loaded values on stack.
@@ -4,58 +4,74 @@
 * See copyright notice in luabins.h
 */
 
+#include <string.h>
+
 #include "luaheaders.h"
 
 #include "luabins.h"
 #include "saveload.h"
+#include "savebuffer.h"
 
-/* Arbitrary number of stack slots to be available on save of each element */
+/* Arbitrary number of stack slots to be available on save of each table */
 #define LUABINS_EXTRASTACK (10)
 
-/* Arbitrary number of used stack slots to trigger preliminary concatenation */
-/* TODO: Should be dependent on LUAI_MAXCSTACK? */
-#define LUABINS_CONCATTHRESHOLD (1024)
-
-/* NOTE: Overhead on string internalization.
-   Use own growing buffer instead of Lua stack.
+/*
+* Amount of buffered data to trigger writer call in luabins_dump().
+* Buffer is flushed between top-level values only.
 */
-#define push_bytes(L, p, n) \
-  lua_pushlstring((L), (char *)(p), (n))
-
-#define push_byte(L, byte) \
-  { char c = (byte); push_bytes((L), &c, 1); }
+#define LUABINS_DUMPFLUSHSIZE (64 * 1024)
 
-static int save_value(lua_State * L, int index, int nesting);
+static int save_value(
+    lua_State * L,
+    lbs_SaveBuffer * sb,
+    int index,
+    int nesting
+  );
 
-/* If retain is 1, retains the top element on stack (slow) */
-static void maybe_concat(lua_State * L, int base, int retain)
+/* Returns 0 on success, non-zero on failure */
+static int save_varint(lbs_SaveBuffer * sb, size_t value)
 {
-  int top = lua_gettop(L);
-  if (top - base >= LUABINS_CONCATTHRESHOLD)
+  unsigned char bytes[LUABINS_MAXVARINTLEN];
+  size_t len = 0;
+
+  while (value >= 0x80)
   {
-    if (retain)
-    {
-      lua_insert(L, base);
-    }
+    bytes[len++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  bytes[len++] = (unsigned char)value;
 
-    lua_concat(L, top - base);
+  return lbsSB_write(sb, bytes, len);
+}
 
-    if (retain)
-    {
-      /* swap result with retained element */
-      lua_pushvalue(L, -2);
-      lua_remove(L, -3);
-    }
+/* Returns non-zero if number is to be saved as LUABINS_CINTEGER */
+static int is_compact_integer(lua_Number num)
+{
+  static const lua_Number zero = 0;
+
+  if (
+      !(num >= LUABINS_MINCOMPACTINT && num <= LUABINS_MAXCOMPACTINT) ||
+      num != (lua_Number)(long)num
+    )
+  {
+    return 0; /* Out of range, fractional or NaN */
   }
+
+  /* Negative zero would lose its sign */
+  return num != 0 || memcmp(&num, &zero, sizeof(lua_Number)) == 0;
 }
 
 /* Returns 0 on success, non-zero on failure */
-static int save_table(lua_State * L, int index, int nesting)
+static int save_table(
+    lua_State * L,
+    lbs_SaveBuffer * sb,
+    int index,
+    int nesting
+  )
 {
   int result = LUABINS_ESUCCESS;
   int array_size = 0;
-  int array_size_pos = 0;
-  int hash_size_pos = 0;
+  int hash_size = 0;
   int total_size = 0;
 
   if (nesting > LUABINS_MAXTABLENESTING)
@@ -63,9 +79,11 @@ static int save_table(lua_State * L, int index, int nesting)
     return LUABINS_ETOODEEP;
   }
 
-  /* TODO: Hauling stack for key and value removal
-     may get too heavy for larger tables. Think out a better way.
-  */
+  /* Ensure that we have have some extra space on stack */
+  if (lua_checkstack(L, LUABINS_EXTRASTACK) == 0)
+  {
+    return LUABINS_ENOSTACK;
+  }
 
   /* If __len metamethod for tables would ever work, this would be broken.
      Note also inelegant downsize from size_t to int.
@@ -78,11 +96,31 @@ static int save_table(lua_State * L, int index, int nesting)
   */
   array_size = (int)lua_objlen(L, index);
 
-  lua_pushnil(L); /* placeholder for array size */
-  array_size_pos = lua_gettop(L);
+  /* Sizes precede table data, so count entries first */
+  lua_pushnil(L);
+  while (lua_next(L, index) != 0)
+  {
+    lua_pop(L, 1);
+    ++total_size;
+  }
+
+  /*
+    Note that if array has holes, lua_objlen may report
+    larger than actual array size. So we need to adjust.
+  */
+  array_size = luabins_min(total_size, array_size);
+  hash_size = luabins_max(0, total_size - array_size);
+
+  result = save_varint(sb, (size_t)array_size);
+  if (result == LUABINS_ESUCCESS)
+  {
+    result = save_varint(sb, (size_t)hash_size);
+  }
 
-  lua_pushnil(L); /* placeholder for hash size */
-  hash_size_pos = array_size_pos + 1;
+  if (result != LUABINS_ESUCCESS)
+  {
+    return result;
+  }
 
   lua_pushnil(L); /* key for lua_next() */
   while (result == LUABINS_ESUCCESS && lua_next(L, index) != 0)
@@ -91,76 +129,43 @@ static int save_table(lua_State * L, int index, int nesting)
     int key_pos = value_pos - 1;
 
     /* Save key. */
-    result = save_value(L, key_pos, nesting);
+    result = save_value(L, sb, key_pos, nesting);
 
     /* Save value. */
     if (result == LUABINS_ESUCCESS)
     {
-      /* Key may be a table with a lot of elements
-         and generate a lot of cruft on stack.
-      */
-      maybe_concat(L, value_pos, 0);
-      result = save_value(L, value_pos, nesting);
+      result = save_value(L, sb, value_pos, nesting);
     }
 
     if (result == LUABINS_ESUCCESS)
     {
-      /* Remove value from stack. */
-      lua_remove(L, value_pos);
-
-      /* Move key to the top for the next iteration. */
-      lua_pushvalue(L, key_pos);
-      lua_remove(L, key_pos);
-
-      /* Value could be a table as well.
-         If stack is too cluttered, concat it
-         while retaining our key on top.
-      */
-      maybe_concat(L, hash_size_pos + 1, 1);
+      /* Remove value from stack, leave key for the next iteration. */
+      lua_pop(L, 1);
     }
-
-    ++total_size;
-  }
-
-  if (result == LUABINS_ESUCCESS)
-  {
-    /*
-      Note that if array has holes, lua_objlen may report
-      larger than actual array size. So we need to adjust.
-    */
-    int hash_size = 0;
-
-    array_size = luabins_min(total_size, array_size);
-    hash_size = luabins_max(0, total_size - array_size);
-
-    push_bytes(L, (unsigned char *)&array_size, LUABINS_LINT);
-    lua_replace(L, array_size_pos);
-
-    push_bytes(L, (unsigned char *)&hash_size, LUABINS_LINT);
-    lua_replace(L, hash_size_pos);
   }
 
   return result;
 }
 
 /* Returns 0 on success, non-zero on failure */
-static int save_value(lua_State * L, int index, int nesting)
+static int save_value(
+    lua_State * L,
+    lbs_SaveBuffer * sb,
+    int index,
+    int nesting
+  )
 {
-  /* Ensure that we have have some extra space on stack */
-  if (lua_checkstack(L, LUABINS_EXTRASTACK) == 0)
-  {
-    return LUABINS_ENOSTACK;
-  }
+  int result = LUABINS_ESUCCESS;
 
   switch (lua_type(L, index))
   {
   case LUA_TNIL:
-    push_byte(L, LUABINS_CNIL);
+    result = lbsSB_writechar(sb, LUABINS_CNIL);
     break;
 
   case LUA_TBOOLEAN:
-    push_byte(
-        L,
+    result = lbsSB_writechar(
+        sb,
         (lua_toboolean(L, index) == 0) ? LUABINS_CFALSE : LUABINS_CTRUE
       );
     break;
@@ -168,29 +173,54 @@ static int save_value(lua_State * L, int index, int nesting)
   case LUA_TNUMBER:
     {
       lua_Number num = lua_tonumber(L, index);
-      push_byte(L, LUABINS_CNUMBER);
-      push_bytes(L, (unsigned char *)&num, LUABINS_LNUMBER);
+      if (is_compact_integer(num))
+      {
+        long value = (long)num;
+        size_t zigzag = (value >= 0)
+          ? ((size_t)value << 1)
+          : (((size_t)(-(value + 1)) << 1) | 1)
+          ;
+
+        result = lbsSB_writechar(sb, LUABINS_CINTEGER);
+        if (result == LUABINS_ESUCCESS)
+        {
+          result = save_varint(sb, zigzag);
+        }
+      }
+      else
+      {
+        result = lbsSB_writechar(sb, LUABINS_CNUMBER);
+        if (result == LUABINS_ESUCCESS)
+        {
+          result = lbsSB_write(sb, (unsigned char *)&num, LUABINS_LNUMBER);
+        }
+      }
     }
     break;
 
   case LUA_TSTRING:
     {
-      size_t len = lua_objlen(L, index);
-      push_byte(L, LUABINS_CSTRING);
-      push_bytes(L, (unsigned char *)&len, LUABINS_LSIZET);
-      lua_pushvalue(L, index);
+      size_t len = 0;
+      const char * str = lua_tolstring(L, index, &len);
+
+      /* One grow call for the whole string record */
+      result = lbsSB_grow(
+          sb, LUABINS_LTYPEBYTE + LUABINS_MAXVARINTLEN + len
+        );
+      if (result == LUABINS_ESUCCESS)
+      {
+        lbsSB_writechar(sb, LUABINS_CSTRING);
+        save_varint(sb, len);
+        lbsSB_write(sb, (const unsigned char *)str, len);
+      }
     }
     break;
 
   case LUA_TTABLE:
+    result = lbsSB_writechar(sb, LUABINS_CTABLE);
+    if (result == LUABINS_ESUCCESS)
     {
-      int result = LUABINS_ESUCCESS;
-      push_byte(L, LUABINS_CTABLE);
-      result = save_table(L, index, nesting + 1);
-      if (result != LUABINS_ESUCCESS)
-      {
-        return result;
-      }
+      result = save_table(L, sb, index, nesting + 1);
     }
     break;
 
@@ -199,22 +229,54 @@ static int save_value(lua_State * L, int index, int nesting)
   case LUA_TTHREAD:
   case LUA_TUSERDATA:
   default:
-    return LUABINS_EBADTYPE;
+    result = LUABINS_EBADTYPE;
+    break;
   }
 
+  return result;
+}
+
+/* Passes buffered data to the writer and empties the buffer */
+static int flush_buffer(
+    lua_State * L,
+    lbs_SaveBuffer * sb,
+    lua_Writer writer,
+    void * ud
+  )
+{
+  if (lbsSB_length(sb) > 0)
+  {
+    if (writer(L, lbsSB_buffer(sb), lbsSB_length(sb), ud) != 0)
+    {
+      return LUABINS_EWRITE;
+    }
+    lbsSB_reset(sb);
+  }
   return LUABINS_ESUCCESS;
 }
 
-int luabins_save(lua_State * L, int index_from, int index_to)
+/*
+* Saves values into sb. If writer is not NULL,
+* data is periodically flushed to it between top-level values.
+* On failure leaves stack at its original state and returns error code.
+*/
+static int save_tuple(
+    lua_State * L,
+    lbs_SaveBuffer * sb,
+    int index_from,
+    int index_to,
+    lua_Writer writer,
+    void * ud
+  )
 {
   unsigned char num_to_save = 0;
   int index = index_from;
   int base = lua_gettop(L);
+  int result = LUABINS_ESUCCESS;
 
   if (index_to - index_from > LUABINS_MAXTUPLE)
   {
-    lua_pushliteral(L, "can't save that many items");
-    return LUABINS_EFAILURE;
+    return LUABINS_ETOOMANY;
   }
 
   /* Allowing to call luabins_save(L, 1, lua_gettop(L))
@@ -234,49 +296,126 @@ int luabins_save(lua_State * L, int index_from, int index_to)
         index_to < 0 || index_to > base
       )
     {
-      lua_pushliteral(L, "inexistant indices");
-      return LUABINS_EFAILURE;
+      return LUABINS_EBADINDEX;
     }
 
     num_to_save = index_to - index_from + 1;
   }
 
-  push_byte(L, num_to_save);
-  for ( ; index <= index_to; ++index)
+  result = lbsSB_writechar(sb, LUABINS_CFORMAT2);
+  if (result == LUABINS_ESUCCESS)
   {
-    int result = 0;
-
-    /* Check if stack has become too huge. */
-    maybe_concat(L, base, 0);
+    result = lbsSB_writechar(sb, num_to_save);
+  }
+  for ( ; result == LUABINS_ESUCCESS && index <= index_to; ++index)
+  {
+    result = save_value(L, sb, index, 0);
 
-    result = save_value(L, index, 0);
-    if (result != LUABINS_ESUCCESS)
+    if (
+        result == LUABINS_ESUCCESS &&
+        writer != NULL &&
+        lbsSB_length(sb) >= LUABINS_DUMPFLUSHSIZE
+      )
     {
-      lua_settop(L, base); /* Discard intermediate results */
-      switch (result)
-      {
-      case LUABINS_EBADTYPE:
-        lua_pushliteral(L, "can't save: unsupported type detected");
-        break;
+      result = flush_buffer(L, sb, writer, ud);
+    }
+  }
 
-      case LUABINS_ETOODEEP:
-        lua_pushliteral(L, "can't save: nesting is too deep");
-        break;
+  if (result == LUABINS_ESUCCESS && writer != NULL)
+  {
+    result = flush_buffer(L, sb, writer, ud);
+  }
 
-      case LUABINS_ENOSTACK:
-        lua_pushliteral(L, "can't save: can't grow stack");
-        break;
+  lua_settop(L, base); /* Discard lua_next() leftovers on failure */
 
-      default: /* Should not happen */
-        lua_pushliteral(L, "save failed");
-        break;
-      }
+  return result;
+}
 
-      return result;
-    }
+/* Pushes error message for failed save, returns public error code */
+static int finish_save(lua_State * L, int result)
+{
+  switch (result)
+  {
+  case LUABINS_ESUCCESS:
+    break;
+
+  case LUABINS_ETOOMANY:
+    lua_pushliteral(L, "can't save that many items");
+    result = LUABINS_EFAILURE;
+    break;
+
+  case LUABINS_EBADINDEX:
+    lua_pushliteral(L, "inexistant indices");
+    result = LUABINS_EFAILURE;
+    break;
+
+  case LUABINS_EBADTYPE:
+    lua_pushliteral(L, "can't save: unsupported type detected");
+    break;
+
+  case LUABINS_ETOODEEP:
+    lua_pushliteral(L, "can't save: nesting is too deep");
+    break;
+
+  case LUABINS_ENOSTACK:
+    lua_pushliteral(L, "can't save: can't grow stack");
+    break;
+
+  case LUABINS_ENOMEM:
+    lua_pushliteral(L, "can't save: not enough memory");
+    break;
+
+  case LUABINS_EWRITE:
+    lua_pushliteral(L, "can't save: writer failed");
+    break;
+
+  default: /* Should not happen */
+    lua_pushliteral(L, "save failed");
+    break;
   }
 
-  lua_concat(L, lua_gettop(L) - base);
+  return result;
+}
 
-  return LUABINS_ESUCCESS;
+int luabins_save(lua_State * L, int index_from, int index_to)
+{
+  lbs_SaveBuffer sb;
+  void * alloc_ud = NULL;
+  lua_Alloc alloc_fn = lua_getallocf(L, &alloc_ud);
+  int result = LUABINS_ESUCCESS;
+
+  lbsSB_init(&sb, alloc_fn, alloc_ud);
+
+  result = save_tuple(L, &sb, index_from, index_to, NULL, NULL);
+  if (result == LUABINS_ESUCCESS)
+  {
+    /* Only one Lua string is created for the whole save */
+    lua_pushlstring(L, (const char *)lbsSB_buffer(&sb), lbsSB_length(&sb));
+  }
+
+  lbsSB_destroy(&sb);
+
+  return finish_save(L, result);
+}
+
+int luabins_dump(
+    lua_State * L,
+    int index_from,
+    int index_to,
+    lua_Writer writer,
+    void * ud
+  )
+{
+  lbs_SaveBuffer sb;
+  void * alloc_ud = NULL;
+  lua_Alloc alloc_fn = lua_getallocf(L, &alloc_ud);
+  int result = LUABINS_ESUCCESS;
+
+  lbsSB_init(&sb, alloc_fn, alloc_ud);
+
+  result = save_tuple(L, &sb, index_from, index_to, writer, ud);
+
+  lbsSB_destroy(&sb);
+
+  return finish_save(L, result);
 }
@@ -0,0 +1,111 @@
+/*
+* savebuffer.c
+* Luabins self-growing byte buffer for save
+* See copyright notice in luabins.h
+*/
+
+#include <string.h>
+
+#include "luaheaders.h"
+
+#include "saveload.h"
+#include "savebuffer.h"
+
+/* Initial allocation, enough for most small values without regrowth */
+#define LUABINS_SAVEBUFFER_MINSIZE (256)
+
+void lbsSB_init(
+    lbs_SaveBuffer * sb,
+    lua_Alloc alloc_fn,
+    void * alloc_ud
+  )
+{
+  sb->alloc_fn = alloc_fn;
+  sb->alloc_ud = alloc_ud;
+
+  sb->buffer = NULL;
+  sb->buf_size = 0;
+  sb->end = 0;
+}
+
+int lbsSB_grow(lbs_SaveBuffer * sb, size_t delta)
+{
+  size_t needed = sb->end + delta;
+  if (needed < sb->end)
+  {
+    return LUABINS_ENOMEM; /* Overflow */
+  }
+
+  if (needed > sb->buf_size)
+  {
+    /* Grow geometrically to keep writes amortized O(1) */
+    size_t new_size = luabins_max(sb->buf_size, LUABINS_SAVEBUFFER_MINSIZE);
+    void * ptr = NULL;
+
+    while (new_size < needed)
+    {
+      size_t next = new_size * 2;
+      new_size = (next > new_size) ? next : needed;
+    }
+
+    ptr = sb->alloc_fn(sb->alloc_ud, sb->buffer, sb->buf_size, new_size);
+    if (ptr == NULL)
+    {
+      return LUABINS_ENOMEM;
+    }
+
+    sb->buffer = (unsigned char *)ptr;
+    sb->buf_size = new_size;
+  }
+
+  return LUABINS_ESUCCESS;
+}
+
+int lbsSB_write(
+    lbs_SaveBuffer * sb,
+    const unsigned char * bytes,
+    size_t length
+  )
+{
+  if (length > 0)
+  {
+    int result = lbsSB_grow(sb, length);
+    if (result != LUABINS_ESUCCESS)
+    {
+      return result;
+    }
+
+    memcpy(&sb->buffer[sb->end], bytes, length);
+    sb->end += length;
+  }
+
+  return LUABINS_ESUCCESS;
+}
+
+int lbsSB_writechar(lbs_SaveBuffer * sb, unsigned char byte)
+{
+  if (sb->end == sb->buf_size)
+  {
+    int result = lbsSB_grow(sb, 1);
+    if (result != LUABINS_ESUCCESS)
+    {
+      return result;
+    }
+  }
+
+  sb->buffer[sb->end++] = byte;
+
+  return LUABINS_ESUCCESS;
+}
+
+void lbsSB_destroy(lbs_SaveBuffer * sb)
+{
+  if (sb->buffer != NULL)
+  {
+    sb->alloc_fn(sb->alloc_ud, sb->buffer, sb->buf_size, 0);
+  }
+
+  sb->buffer = NULL;
+  sb->buf_size = 0;
+  sb->end = 0;
+}
@@ -0,0 +1,58 @@
+/*
+* savebuffer.h
+* Luabins self-growing byte buffer for save
+* See copyright notice in luabins.h
+*/
+
+#ifndef LUABINS_SAVEBUFFER_H_
+#define LUABINS_SAVEBUFFER_H_
+
+/*
+* Memory is taken from the allocator of the Lua state,
+* nothing is pushed on the Lua stack.
+*/
+typedef struct lbs_SaveBuffer
+{
+  lua_Alloc alloc_fn;
+  void * alloc_ud;
+
+  unsigned char * buffer;
+  size_t buf_size;
+  size_t end;
+} lbs_SaveBuffer;
+
+void lbsSB_init(
+    lbs_SaveBuffer * sb,
+    lua_Alloc alloc_fn,
+    void * alloc_ud
+  );
+
+/*
+* Ensures that at least delta more bytes fit into the buffer.
+* Returns 0 on success, non-zero on allocation failure.
+*/
+int lbsSB_grow(lbs_SaveBuffer * sb, size_t delta);
+
+/* Returns 0 on success, non-zero on allocation failure. */
+int lbsSB_write(
+    lbs_SaveBuffer * sb,
+    const unsigned char * bytes,
+    size_t length
+  );
+
+/* Returns 0 on success, non-zero on allocation failure. */
+int lbsSB_writechar(lbs_SaveBuffer * sb, unsigned char byte);
+
+#define lbsSB_length(sb) \
+  ((sb)->end)
+
+#define lbsSB_buffer(sb) \
+  ((const unsigned char *)(sb)->buffer)
+
+/* Forgets buffer contents, keeping allocated memory */
+#define lbsSB_reset(sb) \
+  ((sb)->end = 0)
+
+void lbsSB_destroy(lbs_SaveBuffer * sb);
+
+#endif /* LUABINS_SAVEBUFFER_H_ */
@@ -28,14 +28,42 @@
 #define LUABINS_EBADDATA (5)
 #define LUABINS_ETAILEFT (6)
 #define LUABINS_EBADSIZE (7)
+#define LUABINS_ENOMEM   (8)
+#define LUABINS_EWRITE   (9)
+#define LUABINS_ETOOMANY (10)
+#define LUABINS_EBADINDEX (11)
+
+/*
+* Format version byte.
+* Version 1 data has no header and starts with tuple size,
+* which is never greater than LUABINS_MAXTUPLE,
+* so any larger first byte is free to be used as format mark.
+* Version 2 stores sizes and small integral numbers as varints.
+*/
+#define LUABINS_CFORMAT2 (0xFB)
 
 /* Type bytes */
-#define LUABINS_CNIL    '-'
-#define LUABINS_CFALSE  '0'
-#define LUABINS_CTRUE   '1'
-#define LUABINS_CNUMBER 'N'
-#define LUABINS_CSTRING 'S'
-#define LUABINS_CTABLE  'T'
+#define LUABINS_CNIL     '-'
+#define LUABINS_CFALSE   '0'
+#define LUABINS_CTRUE    '1'
+#define LUABINS_CNUMBER  'N'
+#define LUABINS_CINTEGER 'I' /* Format 2 only */
+#define LUABINS_CSTRING  'S'
+#define LUABINS_CTABLE   'T'
+
+/*
+* Varint is little-endian base 128: seven bits per byte,
+* high bit set on all bytes but last.
+*/
+#define LUABINS_MAXVARINTLEN ((sizeof(size_t) * 8 + 6) / 7)
+
+/*
+* Integral numbers in this range are saved as zigzag-encoded varints
+* (0, -1, 1, -2, ... become 0, 1, 2, 3, ...). Other numbers are saved
+* as is. Range is limited so that zigzag value fits in 32-bit size_t.
+*/
+#define LUABINS_MAXCOMPACTINT (2147483647L)
+#define LUABINS_MINCOMPACTINT (-LUABINS_MAXCOMPACTINT - 1)
 
 /*
 * PORTABILITY WARNING!
@@ -68,13 +96,19 @@
 #define LUABINS_LMINLARGEVALUE \
   ( luabins_min3(LUABINS_LMINTABLE, LUABINS_LMINSTRING, LUABINS_LMINSTRING) )
 
+/*
+* Format 2: minimal table is three bytes, minimal string and integer
+* are type byte and one byte varint.
+*/
+#define LUABINS_LMINLARGEVALUE2 (LUABINS_LTYPEBYTE + 1)
+
 /*
 * Lower limit on total table data size is determined as follows:
 * -- All entries are always key and value.
 * -- Minimum value size is one byte for nil and boolean,
 *    but that is two keys maximum (nil can'be the key).
-* -- All the rest of key types are mimimum of LUABINS_MINLARGEVALUELEN
-*    bytes (type byte plus data bytes).
+* -- All the rest of key types are mimimum of min_large_value
+*    bytes (type byte plus data bytes), which depends on format.
 * -- All values in the table may be booleans.
 *
 * WARNING: Change this if format is changed!
@@ -82,12 +116,12 @@
 * Note this formula does NOT take in account
 * table header (type byte and array/hash sizes).
 */
-#define luabins_min_table_data_size(total_size) \
+#define luabins_min_table_data_size(total_size, min_large_value) \
   ( \
     (total_size > 2) \
       ? ( \
           2 * (LUABINS_LTYPEBYTE + LUABINS_LTYPEBYTE) \
-        + (total_size - 2) * (LUABINS_LMINLARGEVALUE + LUABINS_LTYPEBYTE) \
+        + (total_size - 2) * ((min_large_value) + LUABINS_LTYPEBYTE) \
       ) \
       : (total_size * (LUABINS_LTYPEBYTE + LUABINS_LTYPEBYTE)) \
   )
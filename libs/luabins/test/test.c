@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -103,6 +104,34 @@ void checkerr(lua_State * L, int base, const char * err)
   lua_pop(L, 2); /* Pops error message as well */
 }
 
+typedef struct DumpBuffer
+{
+  unsigned char data[256];
+  size_t length;
+} DumpBuffer;
+
+int dump_writer(lua_State * L, const void * p, size_t sz, void * ud)
+{
+  DumpBuffer * db = (DumpBuffer *)ud;
+  (void)L;
+  if (db->length + sz > sizeof(db->data))
+  {
+    return 1;
+  }
+  memcpy(&db->data[db->length], p, sz);
+  db->length += sz;
+  return 0;
+}
+
+int failing_writer(lua_State * L, const void * p, size_t sz, void * ud)
+{
+  (void)L;
+  (void)p;
+  (void)sz;
+  (void)ud;
+  return 1;
+}
+
 int push_testdataset(lua_State * L)
 {
   int base = lua_gettop(L);
@@ -298,6 +327,47 @@ int main()
 
     check(L, base, 0);
 
+    /* Dump test dataset, must match saved string */
+
+    num_items = push_testdataset(L);
+
+    {
+      DumpBuffer db;
+      db.length = 0;
+
+      if (luabins_dump(L, base + 1, base + num_items, dump_writer, &db) != 0)
+      {
+        fatal(L, "test dataset dump failed");
+      }
+
+      check(L, base, num_items);
+
+      if (luabins_save(L, base + 1, base + num_items) != 0)
+      {
+        fatal(L, "test dataset save failed");
+      }
+
+      str = (const unsigned char *)lua_tolstring(L, -1, &length);
+      if (length != db.length || memcmp(str, db.data, length) != 0)
+      {
+        fatal(L, "dump does not match save");
+      }
+
+      lua_pop(L, 1);
+    }
+
+    if (luabins_dump(L, base + 1, base + num_items, failing_writer, NULL) == 0)
+    {
+      fatal(L, "dump should fail");
+    }
+
+    /* Move error message below dataset and drop the dataset */
+    lua_insert(L, base + 1);
+    lua_pop(L, num_items);
+    checkerr(L, base, "can't save: writer failed");
+
+    check(L, base, 0);
+
     /* Assuming further tests are done in test.lua */
   }
 
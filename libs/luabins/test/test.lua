@@ -282,7 +282,7 @@ do
   do
     local data = { [true] = true }
     local saved = check_ok(data)
-    local expected = "\001".."T".."\000\000\000\000".."\001\000\000\000".."11"
+    local expected = "\251".."\001".."T".."\000".."\001".."11"
     ensure_equals(
         "format sanity check",
         expected,
@@ -290,6 +290,7 @@ do
       )
     check_fail_load("corrupt data: bad size", saved:sub(1, #saved - 1))
 
+    -- Format 1 data (no header, sizes as ints) is still loaded.
     -- As long as array and hash size sum is correct
     -- (and both are within limits), load is successful.
     -- If values are swapped, we get some performance hit.
@@ -331,7 +332,7 @@ do
   do
     local data = { [true] = true, [false] = false }
     local saved = check_ok({ [true] = true, [false] = false })
-    local expected = "\001".."T".."\000\000\000\000".."\002\000\000\000".."0011"
+    local expected = "\251".."\001".."T".."\000".."\002".."0011"
     ensure_equals(
         "format sanity check",
         expected,
@@ -355,10 +356,10 @@ do
   do
     local saved = check_ok({ [true] = true, [false] = false, [1] = true })
     local expected =
-      "\001".."T"
-      .. "\001\000\000\000".."\002\000\000\000"
+      "\251".."\001".."T"
+      .. "\001".."\002"
       .. "0011"
-      .. "N\000\000\000\000\000\000\240\063" -- Note number is a double
+      .. "I\002" -- Note integral number is a zigzag varint
       .. "1"
 
     ensure_equals(
@@ -366,7 +367,7 @@ do
         expected,
         saved
       )
-    check_fail_load("corrupt data", saved:sub(1, #saved - 1))
+    check_fail_load("corrupt data: bad size", saved:sub(1, #saved - 1))
 
     check_fail_load(
         "corrupt data: bad size",
@@ -393,12 +394,12 @@ do
         { [true] = true, [false] = false, [1] = true, [42] = true }
       )
     local expected =
-      "\001".."T"
-      .. "\001\000\000\000".."\003\000\000\000"
+      "\251".."\001".."T"
+      .. "\001".."\003"
       .. "0011"
-      .. "N\000\000\000\000\000\000\069\064"
+      .. "I\084"
       .. "1"
-      .. "N\000\000\000\000\000\000\240\063"
+      .. "I\002"
       .. "1"
 
     ensure_equals(
@@ -406,7 +407,7 @@ do
         expected,
         saved
       )
-    check_fail_load("corrupt data", saved:sub(1, #saved - 1))
+    check_fail_load("corrupt data: bad size", saved:sub(1, #saved - 1))
 
     check_fail_load(
         "corrupt data: bad size",
@@ -434,6 +435,65 @@ end
 
 print("===== MIN TABLE SIZE TESTS OK =====")
 
+print("===== BEGIN FORMAT 2 TESTS =====")
+
+do
+  ensure_equals("empty", check_ok(), "\251\000")
+  ensure_equals("zero", check_ok(0), "\251\001I\000")
+  ensure_equals("one", check_ok(1), "\251\001I\002")
+  ensure_equals("minus one", check_ok(-1), "\251\001I\001")
+  ensure_equals("two byte varint", check_ok(64), "\251\001I\128\001")
+  ensure_equals("short string", check_ok("ab"), "\251\001S\002ab")
+  ensure_equals("empty table", check_ok({ }), "\251\001T\000\000")
+
+  -- Compact integer range boundaries
+  ensure_equals("max int", #check_ok(2147483647), 2 + 1 + 5)
+  ensure_equals("min int", #check_ok(-2147483648), 2 + 1 + 5)
+
+  -- These are saved as full numbers
+  local numsize = #check_ok(math.pi)
+  ensure_equals("above max int", #check_ok(2147483648), numsize)
+  ensure_equals("below min int", #check_ok(-2147483649), numsize)
+  ensure_equals("fraction", #check_ok(0.5), numsize)
+  ensure_equals("infinity", #check_ok(1/0), numsize)
+
+  -- Negative zero keeps its sign
+  local negzero = select(2, luabins.load(check_ok(-1/(1/0))))
+  ensure_equals("negative zero", tostring(1/negzero), tostring(-1/0))
+
+  -- Long string length takes several varint bytes
+  local long = ("x"):rep(300)
+  ensure_equals("long string", check_ok(long), "\251\001S\172\002"..long)
+
+  -- Format 1 data
+  check_load_ok("\001-", nil)
+  check_load_ok("\002" .. "01", false, true)
+  check_fail_load("corrupt data", "\001I\002")
+
+  -- Truncated and overlong varints
+  check_fail_load("corrupt data", "\251\001I\128")
+  check_fail_load("corrupt data", "\251\001S\128")
+  check_fail_load(
+      "corrupt data: bad size",
+      "\251\001S"..("\255"):rep(16).."\001"
+    )
+  check_fail_load("corrupt data: bad size", "\251\001S\002a")
+  check_fail_load(
+      "corrupt data: bad size",
+      "\251\001T\255\255\255\255\015\000"
+    )
+  check_fail_load("corrupt data: bad size", "\251\001T\000\002".."11")
+  check_fail_load("extra data at end", "\251\001T\000\000-")
+
+  -- Integer out of compact range
+  check_fail_load("corrupt data", "\251\001I\128\128\128\128\016")
+
+  check_fail_load("corrupt data", "\251")
+  check_fail_load("corrupt data: bad size", "\251\255")
+end
+
+print("===== FORMAT 2 TESTS OK =====")
+
 print("===== BEGIN LOAD TRUNCATION TESTS =====")
 
 local function gen_random_dataset(num, nesting)
@@ -110,49 +110,98 @@ LUALIB_API const char *luaL_gsub(lua_State *L, const char *s,
 
 /* -- Buffer handling ----------------------------------------------------- */
 
-#define bufflen(B)	((size_t)((B)->p - (B)->buffer))
-#define bufffree(B)	((size_t)(LUAL_BUFFERSIZE - bufflen(B)))
+#define bufflen(B)	((size_t)((B)->p - (B)->b))
+#define bufffree(B)	((B)->size - bufflen(B))
 
-static int emptybuffer(luaL_Buffer *B)
+#define BUFFERBOX	"_BUFFERBOX"
+
+/*
+** Contents that outgrow B->buffer move into a block held by a userdata box
+** on the stack. The block grows in place and the box frees it if an error
+** unwinds the stack before luaL_pushresult.
+*/
+typedef struct BufferBox {
+  void *block;
+  size_t size;
+} BufferBox;
+
+static void *resizebox(lua_State *L, int idx, size_t newsize)
+{
+  void *ud;
+  lua_Alloc allocf = lua_getallocf(L, &ud);
+  BufferBox *box = (BufferBox *)lua_touserdata(L, idx);
+  void *temp = allocf(ud, box->block, box->size, newsize);
+  if (temp == NULL && newsize > 0) {  /* Box still owns the old block. */
+    lua_pushliteral(L, "not enough memory");
+    lua_error(L);
+  }
+  box->block = temp;
+  box->size = newsize;
+  return temp;
+}
+
+static int boxgc(lua_State *L)
 {
-  size_t l = bufflen(B);
-  if (l == 0)
-    return 0;  /* put nothing on stack */
-  lua_pushlstring(B->L, B->buffer, l);
-  B->p = B->buffer;
-  B->lvl++;
-  return 1;
+  resizebox(L, 1, 0);
+  return 0;
 }
 
-static void adjuststack(luaL_Buffer *B)
+static void newbox(lua_State *L)
 {
-  if (B->lvl > 1) {
+  BufferBox *box = (BufferBox *)lua_newuserdata(L, sizeof(BufferBox));
+  box->block = NULL;
+  box->size = 0;
+  if (luaL_newmetatable(L, BUFFERBOX)) {
+    lua_pushcfunction(L, boxgc);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_setmetatable(L, -2);
+}
+
+/* Get at least sz free bytes. The box is (or goes) at boxidx: -1 or -2. */
+static char *prepbuffsize(luaL_Buffer *B, size_t sz, int boxidx)
+{
+  if (bufffree(B) < sz) {
     lua_State *L = B->L;
-    int toget = 1;  /* number of levels to concat */
-    size_t toplen = lua_strlen(L, -1);
-    do {
-      size_t l = lua_strlen(L, -(toget+1));
-      if (!(B->lvl - toget + 1 >= LUA_MINSTACK/2 || toplen > l))
-	break;
-      toplen += l;
-      toget++;
-    } while (toget < B->lvl);
-    lua_concat(L, toget);
-    B->lvl = B->lvl - toget + 1;
+    size_t len = bufflen(B);
+    size_t newsize = B->size * 2;
+    char *newbuff;
+    if (sz > ~(size_t)0 - len)
+      luaL_error(L, "buffer too large");
+    if (newsize < len + sz)
+      newsize = len + sz;
+    if (B->lvl == 0) {  /* Contents still in B->buffer? */
+      newbox(L);
+      lua_insert(L, boxidx);
+      newbuff = (char *)resizebox(L, boxidx, newsize);
+      memcpy(newbuff, B->b, len);
+      B->lvl = 1;
+    } else {
+      newbuff = (char *)resizebox(L, boxidx, newsize);
+    }
+    B->b = newbuff;
+    B->p = newbuff + len;
+    B->size = newsize;
   }
+  return B->p;
+}
+
+LUALIB_API char *luaL_prepbuffsize(luaL_Buffer *B, size_t sz)
+{
+  return prepbuffsize(B, sz, -1);
 }
 
 LUALIB_API char *luaL_prepbuffer(luaL_Buffer *B)
 {
-  if (emptybuffer(B))
-    adjuststack(B);
-  return B->buffer;
+  return prepbuffsize(B, LUAL_BUFFERSIZE, -1);
 }
 
 LUALIB_API void luaL_addlstring(luaL_Buffer *B, const char *s, size_t l)
 {
-  while (l--)
-    luaL_addchar(B, *s++);
+  if (l > 0) {
+    memcpy(prepbuffsize(B, l, -1), s, l);
+    luaL_addsize(B, l);
+  }
 }
 
 LUALIB_API void luaL_addstring(luaL_Buffer *B, const char *s)
@@ -162,9 +211,15 @@ LUALIB_API void luaL_addstring(luaL_Buffer *B, const char *s)
 
 LUALIB_API void luaL_pushresult(luaL_Buffer *B)
 {
-  emptybuffer(B);
-  lua_concat(B->L, B->lvl);
-  B->lvl = 1;
+  lua_State *L = B->L;
+  lua_pushlstring(L, B->b, bufflen(B));
+  if (B->lvl) {  /* Free the block now, not at the next collection. */
+    resizebox(L, -2, 0);
+    lua_remove(L, -2);
+    B->lvl = 0;
+  }
+  B->b = B->p = B->buffer;
+  B->size = LUAL_BUFFERSIZE;
 }
 
 LUALIB_API void luaL_addvalue(luaL_Buffer *B)
@@ -172,22 +227,18 @@ LUALIB_API void luaL_addvalue(luaL_Buffer *B)
   lua_State *L = B->L;
   size_t vl;
   const char *s = lua_tolstring(L, -1, &vl);
-  if (vl <= bufffree(B)) {  /* fit into buffer? */
-    memcpy(B->p, s, vl);  /* put it there */
-    B->p += vl;
-    lua_pop(L, 1);  /* remove from stack */
-  } else {
-    if (emptybuffer(B))
-      lua_insert(L, -2);  /* put buffer before new value */
-    B->lvl++;  /* add new value into B stack */
-    adjuststack(B);
+  if (vl > 0) {  /* The box goes below the value. */
+    memcpy(prepbuffsize(B, vl, -2), s, vl);
+    luaL_addsize(B, vl);
   }
+  lua_pop(L, 1);
 }
 
 LUALIB_API void luaL_buffinit(lua_State *L, luaL_Buffer *B)
 {
   B->L = L;
-  B->p = B->buffer;
+  B->b = B->p = B->buffer;
+  B->size = LUAL_BUFFERSIZE;
   B->lvl = 0;
 }
 
@@ -352,13 +352,16 @@ LJLIB_CF(gcinfo)
 LJLIB_CF(collectgarbage)
 {
   int opt = lj_lib_checkopt(L, 1, LUA_GCCOLLECT,  /* ORDER LUA_GC* */
-    "\4stop\7restart\7collect\5count\1\377\4step\10setpause\12setstepmul");
+    "\4stop\7restart\7collect\5count\1\377\4step\10setpause\12setstepmul"
+    "\1\377\1\377\5stats\10steptime");
   int32_t data = lj_lib_optint(L, 2, 0);
   if (opt == LUA_GCCOUNT) {
     setnumV(L->top-1, cast_num((int32_t)G(L)->gc.total)/1024.0);
+  } else if (opt == LUA_GCSTATS) {
+    lua_gc(L, opt, data);  /* Pushes the table. */
   } else {
     int res = lua_gc(L, opt, data);
-    if (opt == LUA_GCSTEP)
+    if (opt == LUA_GCSTEP || opt == LUA_GCSTEPTIME)
       setboolV(L->top-1, res);
     else
       setintV(L->top-1, res);
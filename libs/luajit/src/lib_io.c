@@ -159,14 +159,17 @@ static int io_file_readchars(lua_State *L, FILE *fp, size_t n)
   size_t nr;  /* number of chars actually read */
   luaL_Buffer b;
   luaL_buffinit(L, &b);
-  rlen = LUAL_BUFFERSIZE;  /* try to read that much each time */
-  do {
-    char *p = luaL_prepbuffer(&b);
+  rlen = LUAL_BUFFERSIZE;  /* first read, doubles as the buffer grows */
+  for (;;) {
+    char *p;
     if (rlen > n) rlen = n;  /* cannot read more than asked */
+    p = luaL_prepbuffsize(&b, rlen);
     nr = fread(p, 1, rlen, fp);
     luaL_addsize(&b, nr);
     n -= nr;  /* still have to read `n' chars */
-  } while (n > 0 && nr == rlen);  /* until end of count or eof */
+    if (n == 0 || nr < rlen) break;  /* end of count or eof */
+    rlen *= 2;
+  }
   luaL_pushresult(&b);  /* close buffer */
   return (n == 0 || lua_objlen(L, -1) > 0);
 }
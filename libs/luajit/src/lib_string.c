@@ -394,6 +394,79 @@ static const char *match(MatchState *ms, const char *s, const char *p)
   }
 }
 
+/* False first-byte candidates tolerated before lmemfind goes Two-Way. */
+#define LMEMFIND_MISSES	16
+
+static size_t maxsuffix(const uint8_t *n, size_t l, int rev, size_t *period)
+{
+  size_t ip = (size_t)-1;  /* Start of the suffix, minus 1. */
+  size_t jp = 0, k = 1, p = 1;
+  while (jp+k < l) {
+    uint8_t a = n[ip+k], b = n[jp+k];
+    if (a == b) {
+      if (k == p) { jp += p; k = 1; } else { k++; }
+    } else if (rev ? a < b : a > b) {
+      jp += k; k = 1;
+      p = jp - ip;
+    } else {
+      ip = jp++;
+      k = p = 1;
+    }
+  }
+  *period = p;
+  return ip;
+}
+
+/*
+** Two-Way string matching (Crochemore-Perrin) of n (l > 1) inside h,
+** skipping windows by their last byte. Linear in the worst case.
+*/
+static const char *twoway(const uint8_t *h, size_t lh,
+			  const uint8_t *n, size_t l)
+{
+  const uint8_t *z = h + lh;
+  size_t ms, ms2, p, p2, mem, mem0, i, k;
+  uint8_t byteset[32];
+  size_t shift[256];  /* Only valid for bytes in byteset. */
+  memset(byteset, 0, sizeof(byteset));
+  for (i = 0; i < l; i++) {
+    byteset[n[i] >> 3] |= (uint8_t)(1u << (n[i] & 7));
+    shift[n[i]] = i+1;
+  }
+  /* Critical factorization: the larger of both maximal suffixes. */
+  ms = maxsuffix(n, l, 0, &p);
+  ms2 = maxsuffix(n, l, 1, &p2);
+  if (ms2+1 > ms+1) { ms = ms2; p = p2; }
+  if (memcmp(n, n+p, ms+1) != 0) {  /* Not periodic? */
+    mem0 = 0;
+    p = ((ms > l-ms-1) ? ms : l-ms-1) + 1;
+  } else {
+    mem0 = l-p;
+  }
+  mem = 0;
+  while ((size_t)(z-h) >= l) {
+    uint8_t c = h[l-1];  /* Last byte of the window. */
+    if (!(byteset[c >> 3] & (1u << (c & 7)))) {
+      h += l; mem = 0;
+      continue;
+    }
+    k = l-shift[c];
+    if (k) {
+      h += (k < mem) ? mem : k; mem = 0;
+      continue;
+    }
+    for (k = (ms+1 > mem) ? ms+1 : mem; k < l && n[k] == h[k]; k++) ;
+    if (k < l) {  /* Mismatch in the right half. */
+      h += k-ms; mem = 0;
+      continue;
+    }
+    for (k = ms+1; k > mem && n[k-1] == h[k-1]; k--) ;
+    if (k <= mem) return (const char *)h;
+    h += p; mem = mem0;
+  }
+  return NULL;
+}
+
 static const char *lmemfind(const char *s1, size_t l1,
 			    const char *s2, size_t l2)
 {
@@ -401,23 +474,464 @@ static const char *lmemfind(const char *s1, size_t l1,
     return s1;  /* empty strings are everywhere */
   } else if (l2 > l1) {
     return NULL;  /* avoids a negative `l1' */
+  } else if (l2 == 1) {
+    return (const char *)memchr(s1, *s2, l1);
   } else {
     const char *init;  /* to search for a `*s2' inside `s1' */
-    l2--;  /* 1st char will be checked by `memchr' */
-    l1 = l1-l2;  /* `s2' cannot be found after that */
-    while (l1 > 0 && (init = (const char *)memchr(s1, *s2, l1)) != NULL) {
-      init++;   /* 1st char is already checked */
-      if (memcmp(init, s2+1, l2) == 0) {
-	return init-1;
-      } else {  /* correct `l1' and `s1' to try again */
-	l1 -= (size_t)(init-s1);
-	s1 = init;
-      }
+    const char *end = s1+l1;
+    const char *last = end-l2;  /* `s2' cannot be found after that */
+    int misses = 0;
+    while (s1 <= last &&
+	   (init = (const char *)memchr(s1, *s2, (size_t)(last-s1+1))) != NULL) {
+      /* Check the last char before the rest. */
+      if (init[l2-1] == s2[l2-1] && memcmp(init+1, s2+1, l2-2) == 0)
+	return init;
+      s1 = init+1;
+      if (++misses == LMEMFIND_MISSES)  /* Common first char? */
+	return twoway((const uint8_t *)s1, (size_t)(end-s1),
+		      (const uint8_t *)s2, l2);
     }
     return NULL;  /* not found */
   }
 }
 
+/* -- Compiled patterns --------------------------------------------------- */
+
+/*
+** A pattern is translated once into a list of items with precomputed
+** class bitmaps. Programs are cached per state, keyed by the pattern
+** string, in the (weak) environment of the matching functions.
+** Patterns the compiler cannot prove valid are left to match(), which
+** throws the usual errors.
+*/
+
+/* Item opcodes. */
+enum {
+  PI_END,	/* End of pattern. */
+  PI_DOLLAR,	/* `$' at end of pattern. */
+  PI_STR,	/* `len' literal characters. */
+  PI_CHAR,	/* Single (repeated) character. */
+  PI_SET,	/* Single (repeated) character class. */
+  PI_OPEN,	/* Start capture. */
+  PI_POSITION,	/* Position capture. */
+  PI_CLOSE,	/* End capture. */
+  PI_BALANCE,	/* %b */
+  PI_FRONTIER,	/* %f */
+  PI_BACKREF	/* %1-%9 */
+};
+
+#define PSET_SIZE	32
+#define psetbit(st, c)	((st)[(c) >> 3] |= (uint8_t)(1u << ((c) & 7)))
+#define ptestbit(st, c)	((st)[(c) >> 3] & (1u << ((c) & 7)))
+
+typedef struct PatItem {
+  uint8_t op;
+  uint8_t rep;		/* `?', `*', `+', `-' or 0. */
+  uint8_t c;		/* Character, capture index or %b opening delimiter. */
+  uint8_t c2;		/* %b closing delimiter. */
+  size_t len;		/* Length of a PI_STR. */
+  const uint8_t *set;	/* Class bitmap or PI_STR characters. */
+} PatItem;
+
+typedef struct Pattern {
+  int anchor;		/* Pattern starts with `^'? */
+  const PatItem *prefix;	/* Literal every match starts with, or NULL. */
+  int firstc;		/* Character every match starts with, or -1. */
+  const uint8_t *first;	/* Class every match starts with, or NULL. */
+  PatItem item[1];	/* Followed by class bitmaps and literal characters. */
+} Pattern;
+
+typedef struct CompileState {
+  PatItem *item;	/* NULL when only sizing the program. */
+  uint8_t *data;
+  size_t nitems;
+  size_t ndata;
+  int lastop;
+  PatItem scratch;
+} CompileState;
+
+static const char *pclassend(const char *p)
+{
+  switch (*p++) {
+  case L_ESC:
+    return *p == '\0' ? NULL : p+1;
+  case '[':
+    if (*p == '^') p++;
+    do {  /* look for a `]' */
+      if (*p == '\0')
+	return NULL;
+      if (*(p++) == L_ESC && *p != '\0')
+	p++;  /* skip escapes (e.g. `%]') */
+    } while (*p != ']');
+    return p+1;
+  default:
+    return p;
+  }
+}
+
+static PatItem *pat_additem(CompileState *cs, int op)
+{
+  PatItem *it = cs->item ? &cs->item[cs->nitems] : &cs->scratch;
+  cs->nitems++;
+  cs->lastop = op;
+  it->op = (uint8_t)op;
+  it->rep = it->c = it->c2 = 0;
+  it->len = 0;
+  it->set = NULL;
+  return it;
+}
+
+static uint8_t *pat_adddata(CompileState *cs, size_t n)
+{
+  uint8_t *d = cs->data ? cs->data + cs->ndata : NULL;
+  cs->ndata += n;
+  return d;
+}
+
+static const uint8_t *pat_addset(CompileState *cs, const char *p,
+				 const char *ep)
+{
+  uint8_t *st = pat_adddata(cs, PSET_SIZE);
+  if (st) {
+    int c;
+    memset(st, 0, PSET_SIZE);
+    for (c = 0; c < 256; c++)
+      if (singlematch(c, p, ep)) psetbit(st, c);
+  }
+  return st;
+}
+
+static void pat_addliteral(CompileState *cs, int c)
+{
+  uint8_t *d = pat_adddata(cs, 1);
+  if (cs->lastop != PI_STR)  /* Start a new run? */
+    pat_additem(cs, PI_STR)->set = d;
+  if (d) {
+    *d = (uint8_t)c;
+    cs->item[cs->nitems-1].len++;
+  }
+}
+
+/*
+** Mirrors match(): returns 0 wherever match() could throw an error.
+** Capture levels are static along a pattern, so captures to close and
+** back references are resolved here.
+*/
+static int pat_compile(CompileState *cs, const char *p)
+{
+  int level = 0;  /* Captures started so far. */
+  int nopen = 0;
+  int open[LUA_MAXCAPTURES];  /* Unfinished captures. */
+  char done[LUA_MAXCAPTURES];  /* Capture may be back-referenced? */
+  PatItem *it;
+  for (;;) {
+    switch (*p) {
+    case '(':
+      if (level >= LUA_MAXCAPTURES) return 0;  /* Too many captures. */
+      if (*(p+1) == ')') {  /* Position capture? */
+	it = pat_additem(cs, PI_POSITION);
+	done[level] = 1;
+	p += 2;
+      } else {
+	it = pat_additem(cs, PI_OPEN);
+	open[nopen++] = level;
+	done[level] = 0;
+	p++;
+      }
+      it->c = (uint8_t)level++;
+      continue;
+    case ')':
+      if (nopen == 0) return 0;  /* Invalid pattern capture. */
+      it = pat_additem(cs, PI_CLOSE);
+      it->c = (uint8_t)open[--nopen];
+      done[it->c] = 1;
+      p++;
+      continue;
+    case L_ESC:
+      switch (*(p+1)) {
+      case 'b':
+	if (*(p+2) == '\0' || *(p+3) == '\0') return 0;  /* Unbalanced. */
+	it = pat_additem(cs, PI_BALANCE);
+	it->c = uchar(*(p+2));
+	it->c2 = uchar(*(p+3));
+	p += 4;
+	continue;
+      case 'f': {
+	const char *ep;
+	p += 2;
+	if (*p != '[' || (ep = pclassend(p)) == NULL) return 0;
+	it = pat_additem(cs, PI_FRONTIER);
+	it->set = pat_addset(cs, p, ep);
+	p = ep;
+	continue;
+	}
+      default:
+	if (lj_ctype_isdigit(uchar(*(p+1)))) {
+	  int l = *(p+1) - '1';
+	  if (l < 0 || l >= level || !done[l]) return 0;
+	  it = pat_additem(cs, PI_BACKREF);
+	  it->c = (uint8_t)l;
+	  p += 2;
+	  continue;
+	}
+	goto dflt;
+      }
+    case '\0':
+      pat_additem(cs, PI_END);
+      return 1;
+    case '$':
+      if (*(p+1) == '\0') {
+	pat_additem(cs, PI_DOLLAR);
+	return 1;
+      }
+      goto dflt;
+    default: dflt: {
+      const char *ep = pclassend(p);
+      int literal, rep;
+      if (ep == NULL) return 0;  /* Malformed class. */
+      literal = *p == L_ESC ? !lj_ctype_isalnum(uchar(*(p+1))) :
+			      (*p != '.' && *p != '[');
+      rep = (*ep != '\0' && strchr("?*+-", *ep) != NULL) ? *ep : 0;
+      if (literal && !rep) {
+	pat_addliteral(cs, uchar(*(ep-1)));
+      } else if (literal) {
+	it = pat_additem(cs, PI_CHAR);
+	it->c = uchar(*(ep-1));
+	it->rep = (uint8_t)rep;
+      } else {
+	it = pat_additem(cs, PI_SET);
+	it->set = pat_addset(cs, p, ep);
+	it->rep = (uint8_t)rep;
+      }
+      p = rep ? ep+1 : ep;
+      continue;
+      }
+    }
+  }
+}
+
+static void pat_setfirst(Pattern *pt)
+{
+  const PatItem *pi = pt->item;
+  while (pi->op == PI_OPEN || pi->op == PI_POSITION) pi++;
+  pt->prefix = NULL;
+  pt->firstc = -1;
+  pt->first = NULL;
+  if (pi->op == PI_STR) {
+    pt->prefix = pi;
+  } else if (pi->op == PI_BALANCE) {
+    pt->firstc = pi->c;
+  } else if (pi->rep == 0 || pi->rep == '+') {  /* At least one repetition. */
+    if (pi->op == PI_CHAR) pt->firstc = pi->c;
+    else if (pi->op == PI_SET) pt->first = pi->set;
+  }
+}
+
+/* Push the compiled form of pattern p (or nil, if it has none). */
+static const Pattern *pat_new(lua_State *L, const char *p)
+{
+  CompileState cs;
+  Pattern *pt;
+  int anchor = (*p == '^') ? (p++, 1) : 0;
+  cs.item = NULL;
+  cs.data = NULL;
+  cs.nitems = cs.ndata = 0;
+  cs.lastop = PI_END;
+  if (!pat_compile(&cs, p)) {
+    lua_pushnil(L);
+    return NULL;
+  }
+  pt = (Pattern *)lua_newuserdata(L, sizeof(Pattern) +
+				  (cs.nitems-1)*sizeof(PatItem) + cs.ndata);
+  cs.item = pt->item;
+  cs.data = (uint8_t *)(pt->item + cs.nitems);
+  cs.nitems = cs.ndata = 0;
+  cs.lastop = PI_END;
+  pat_compile(&cs, p);
+  pt->anchor = anchor;
+  pat_setfirst(pt);
+  return pt;
+}
+
+/* Push the compiled form of the pattern at arg (or nil). Keep it there. */
+static const Pattern *pat_get(lua_State *L, int arg)
+{
+  const Pattern *pt;
+  lua_pushvalue(L, arg);
+  lua_rawget(L, LUA_ENVIRONINDEX);
+  pt = (const Pattern *)lua_touserdata(L, -1);
+  if (pt == NULL) {
+    lua_pop(L, 1);
+    pt = pat_new(L, lua_tostring(L, arg));
+    if (pt != NULL) {
+      lua_pushvalue(L, arg);
+      lua_pushvalue(L, -2);
+      lua_rawset(L, LUA_ENVIRONINDEX);
+    }
+  }
+  return pt;
+}
+
+/* Skip positions where no match of pt can start. */
+static const char *pat_skip(const Pattern *pt, const char *s, const char *e)
+{
+  if (pt->prefix) {
+    s = lmemfind(s, (size_t)(e - s), (const char *)pt->prefix->set,
+		 pt->prefix->len);
+    return s ? s : e;
+  } else if (pt->firstc >= 0) {
+    s = (const char *)memchr(s, pt->firstc, (size_t)(e - s));
+    return s ? s : e;
+  } else if (pt->first) {
+    while (s < e && !ptestbit(pt->first, uchar(*s))) s++;
+  }
+  return s;
+}
+
+#define itemmatch(pi, ch) \
+  ((pi)->op == PI_CHAR ? (ch) == (pi)->c : ptestbit((pi)->set, (ch)))
+
+static const char *cmatch(MatchState *ms, const char *s, const PatItem *pi);
+
+static const char *cmatchbalance(MatchState *ms, const char *s,
+				 const PatItem *pi)
+{
+  if (uchar(*s) != pi->c) {
+    return NULL;
+  } else {
+    int cont = 1;
+    while (++s < ms->src_end) {
+      if (uchar(*s) == pi->c2) {
+	if (--cont == 0) return s+1;
+      } else if (uchar(*s) == pi->c) {
+	cont++;
+      }
+    }
+  }
+  return NULL;  /* string ends out of balance */
+}
+
+static const char *cmax_expand(MatchState *ms, const char *s,
+			       const PatItem *pi)
+{
+  ptrdiff_t i = 0;  /* counts maximum expand for item */
+  while ((s+i)<ms->src_end && itemmatch(pi, uchar(*(s+i))))
+    i++;
+  if ((pi+1)->op == PI_END)  /* Nothing else to match? */
+    return s+i;
+  /* keeps trying to match with the maximum repetitions */
+  while (i>=0) {
+    const char *res = cmatch(ms, (s+i), pi+1);
+    if (res) return res;
+    i--;  /* else didn't match; reduce 1 repetition to try again */
+  }
+  return NULL;
+}
+
+static const char *cmin_expand(MatchState *ms, const char *s,
+			       const PatItem *pi)
+{
+  for (;;) {
+    const char *res = cmatch(ms, s, pi+1);
+    if (res != NULL)
+      return res;
+    else if (s<ms->src_end && itemmatch(pi, uchar(*s)))
+      s++;  /* try with one more repetition */
+    else
+      return NULL;
+  }
+}
+
+static const char *cstart_capture(MatchState *ms, const char *s,
+				  const PatItem *pi, int what)
+{
+  const char *res;
+  int level = ms->level;
+  ms->capture[level].init = s;
+  ms->capture[level].len = what;
+  ms->level = level+1;
+  if ((res=cmatch(ms, s, pi)) == NULL)  /* match failed? */
+    ms->level--;  /* undo capture */
+  return res;
+}
+
+static const char *cend_capture(MatchState *ms, const char *s,
+				const PatItem *pi)
+{
+  int l = pi->c;
+  const char *res;
+  ms->capture[l].len = s - ms->capture[l].init;  /* close capture */
+  if ((res = cmatch(ms, s, pi+1)) == NULL)  /* match failed? */
+    ms->capture[l].len = CAP_UNFINISHED;  /* undo capture */
+  return res;
+}
+
+static const char *cmatch(MatchState *ms, const char *s, const PatItem *pi)
+{
+  init: /* using goto's to optimize tail recursion */
+  switch (pi->op) {
+  case PI_END:
+    return s;  /* match succeeded */
+  case PI_DOLLAR:
+    return (s == ms->src_end) ? s : NULL;
+  case PI_STR:
+    if ((size_t)(ms->src_end-s) < pi->len ||
+	memcmp(s, pi->set, pi->len) != 0) return NULL;
+    s += pi->len; pi++;
+    goto init;
+  case PI_OPEN:
+    return cstart_capture(ms, s, pi+1, CAP_UNFINISHED);
+  case PI_POSITION:
+    return cstart_capture(ms, s, pi+1, CAP_POSITION);
+  case PI_CLOSE:
+    return cend_capture(ms, s, pi);
+  case PI_BALANCE:
+    s = cmatchbalance(ms, s, pi);
+    if (s == NULL) return NULL;
+    pi++;
+    goto init;
+  case PI_FRONTIER: {
+    int previous = (s == ms->src_init) ? '\0' : uchar(*(s-1));
+    if (ptestbit(pi->set, previous) || !ptestbit(pi->set, uchar(*s)))
+      return NULL;
+    pi++;
+    goto init;
+    }
+  case PI_BACKREF: {
+    size_t len = (size_t)ms->capture[pi->c].len;
+    if ((size_t)(ms->src_end-s) < len ||
+	memcmp(ms->capture[pi->c].init, s, len) != 0) return NULL;
+    s += len; pi++;
+    goto init;
+    }
+  default: {  /* PI_CHAR or PI_SET */
+    int m = s<ms->src_end && itemmatch(pi, uchar(*s));
+    switch (pi->rep) {
+    case '?': {  /* optional */
+      const char *res;
+      if (m && ((res=cmatch(ms, s+1, pi+1)) != NULL))
+	return res;
+      pi++;
+      goto init;  /* else return cmatch(ms, s, pi+1); */
+      }
+    case '*':  /* 0 or more repetitions */
+      return cmax_expand(ms, s, pi);
+    case '+':  /* 1 or more repetitions */
+      return (m ? cmax_expand(ms, s+1, pi) : NULL);
+    case '-':  /* 0 or more repetitions (minimum) */
+      return cmin_expand(ms, s, pi);
+    default:
+      if (!m) return NULL;
+      s++; pi++;
+      goto init;  /* else return cmatch(ms, s+1, pi+1); */
+    }
+    }
+  }
+}
+
+#define domatch(ms, pt, s, p) \
+  ((pt) ? cmatch((ms), (s), (pt)->item) : match((ms), (s), (p)))
+
 static void push_onecapture(MatchState *ms, int i, const char *s, const char *e)
 {
   if (i >= ms->level) {
@@ -473,6 +987,7 @@ static int str_find_aux(lua_State *L, int find)
     }
   } else {
     MatchState ms;
+    const Pattern *pt = pat_get(L, 2);
     int anchor = (*p == '^') ? (p++, 1) : 0;
     const char *s1=s+init;
     ms.L = L;
@@ -481,7 +996,8 @@ static int str_find_aux(lua_State *L, int find)
     do {
       const char *res;
       ms.level = 0;
-      if ((res=match(&ms, s1, p)) != NULL) {
+      if (pt && !anchor) s1 = pat_skip(pt, s1, ms.src_end);
+      if ((res=domatch(&ms, pt, s1, p)) != NULL) {
 	if (find) {
 	  lua_pushinteger(L, s1-s+1);  /* start */
 	  lua_pushinteger(L, res-s);   /* end */
@@ -512,6 +1028,9 @@ LJLIB_NOREG LJLIB_CF(string_gmatch_aux)
   GCstr *str = strV(lj_lib_upvalue(L, 1));
   const char *s = strdata(str);
   TValue *tvpos = lj_lib_upvalue(L, 3);
+  TValue *tvpt = lj_lib_upvalue(L, 4);
+  const Pattern *pt = tvisudata(tvpt) ? (const Pattern *)uddata(udataV(tvpt)) :
+					NULL;
   const char *src = s + tvpos->u32.lo;
   MatchState ms;
   ms.L = L;
@@ -520,7 +1039,8 @@ LJLIB_NOREG LJLIB_CF(string_gmatch_aux)
   for (; src <= ms.src_end; src++) {
     const char *e;
     ms.level = 0;
-    if ((e = match(&ms, src, p)) != NULL) {
+    if (pt) src = pat_skip(pt, src, ms.src_end);
+    if ((e = domatch(&ms, pt, src, p)) != NULL) {
       int32_t pos = (int32_t)(e - s);
       if (e == src) pos++;  /* Ensure progress for empty match. */
       tvpos->u32.lo = (uint32_t)pos;
@@ -536,7 +1056,11 @@ LJLIB_CF(string_gmatch)
   lj_lib_checkstr(L, 2);
   L->top = L->base+3;
   (L->top-1)->u64 = 0;
-  lua_pushcclosure(L, lj_cf_string_gmatch_aux, 3);
+  if (*strVdata(L->base+1) == '^')  /* Not an anchor here. */
+    lua_pushnil(L);
+  else
+    pat_get(L, 2);
+  lua_pushcclosure(L, lj_cf_string_gmatch_aux, 4);
   funcV(L->top-1)->c.ffid = FF_string_gmatch_aux;
   return 1;
 }
@@ -603,11 +1127,13 @@ LJLIB_CF(string_gsub)
   int max_s = luaL_optint(L, 4, (int)(srcl+1));
   int anchor = (*p == '^') ? (p++, 1) : 0;
   int n = 0;
+  const Pattern *pt;
   MatchState ms;
   luaL_Buffer b;
   if (!(tr == LUA_TNUMBER || tr == LUA_TSTRING ||
 	tr == LUA_TFUNCTION || tr == LUA_TTABLE))
     lj_err_arg(L, 3, LJ_ERR_NOSFT);
+  pt = pat_get(L, 2);
   luaL_buffinit(L, &b);
   ms.L = L;
   ms.src_init = src;
@@ -615,17 +1141,24 @@ LJLIB_CF(string_gsub)
   while (n < max_s) {
     const char *e;
     ms.level = 0;
-    e = match(&ms, src, p);
+    e = domatch(&ms, pt, src, p);
     if (e) {
       n++;
       add_value(&ms, &b, src, e);
     }
-    if (e && e>src) /* non empty match? */
+    if (e && e>src) { /* non empty match? */
       src = e;  /* skip it */
-    else if (src < ms.src_end)
-      luaL_addchar(&b, *src++);
-    else
+    } else if (src < ms.src_end) {
+      if (pt && !anchor) {  /* Copy everything up to the next candidate. */
+	const char *next = pat_skip(pt, src+1, ms.src_end);
+	luaL_addlstring(&b, src, (size_t)(next-src));
+	src = next;
+      } else {
+	luaL_addchar(&b, *src++);
+      }
+    } else {
       break;
+    }
     if (anchor)
       break;
   }
@@ -772,6 +1305,25 @@ LJLIB_CF(string_format)
 
 #include "lj_libdef.h"
 
+/* Make a weak cache of compiled patterns the environment of the matchers. */
+static void string_patcache(lua_State *L)
+{
+  static const char *const matchers[] = { "find", "match", "gmatch", "gsub" };
+  int i;
+  lua_newtable(L);
+  lua_createtable(L, 0, 1);
+  lua_pushliteral(L, "v");
+  lua_setfield(L, -2, "__mode");
+  lua_setmetatable(L, -2);
+  for (i = 0; i < (int)(sizeof(matchers)/sizeof(matchers[0])); i++) {
+    lua_getfield(L, -2, matchers[i]);
+    lua_pushvalue(L, -2);
+    lua_setfenv(L, -2);
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+}
+
 LUALIB_API int luaopen_string(lua_State *L)
 {
   GCtab *mt;
@@ -788,6 +1340,7 @@ LUALIB_API int luaopen_string(lua_State *L)
   if (isdead(G(L), obj2gco(mmstr))) flipwhite(obj2gco(mmstr));
   settabV(L, lj_tab_setstr(L, mt, mmstr), tabV(L->top-1));
   mt->nomm = cast_byte(~(1u<<MM_index));
+  string_patcache(L);
   return 1;
 }
 
@@ -16,6 +16,7 @@
 #include "lj_obj.h"
 #include "lj_gc.h"
 #include "lj_err.h"
+#include "lj_str.h"
 #include "lj_tab.h"
 #include "lj_lib.h"
 
@@ -117,6 +118,25 @@ LJLIB_CF(table_insert)		LJLIB_REC(.)
   return 0;
 }
 
+LJLIB_CF(table_clear)
+{
+  lj_tab_clear(lj_lib_checktab(L, 1));
+  return 0;
+}
+
+LJLIB_CF(table_new)
+{
+  int32_t narr = lj_lib_optint(L, 1, 0);
+  int32_t nrec = lj_lib_optint(L, 2, 0);
+  GCtab *t;
+  if (narr < 0) lj_err_arg(L, 1, LJ_ERR_SIZERNG);
+  if (nrec < 0) lj_err_arg(L, 2, LJ_ERR_SIZERNG);
+  lj_gc_check(L);
+  t = lj_tab_new(L, narr > 0 ? (uint32_t)narr+1 : 0, hsize2hbits(nrec));
+  settabV(L, L->top++, t);
+  return 1;
+}
+
 LJLIB_CF(table_remove)		LJLIB_REC(.)
 {
   GCtab *t = lj_lib_checktab(L, 1);
@@ -148,6 +168,35 @@ LJLIB_CF(table_concat)
   int32_t i = lj_lib_optint(L, 3, 1);
   int32_t e = L->base+3 < L->top ? lj_lib_checkint(L, 4) :
 				   (int32_t)lj_tab_len(t);
+  if (i <= e) {
+    /* Strings only: add up the result length, then copy every piece once. */
+    uint64_t len = (uint64_t)seplen * (uint64_t)((int64_t)e - i);
+    int32_t k;
+    for (k = i; ; k++) {
+      cTValue *o = lj_tab_getint(t, k);
+      if (!(o && tvisstr(o)))
+	goto usebuf;  /* Numbers need conversion, others raise an error. */
+      len += strV(o)->len;
+      if (k == e) break;
+    }
+    if (len <= LJ_MAX_STR) {
+      char *buf = lj_str_needbuf(L, &G(L)->tmpbuf, (MSize)len);
+      for (k = i; ; k++) {
+	GCstr *s = strV(lj_tab_getint(t, k));
+	memcpy(buf, strdata(s), s->len);
+	buf += s->len;
+	if (k == e) break;
+	if (seplen) {
+	  memcpy(buf, strdata(sep), seplen);
+	  buf += seplen;
+	}
+      }
+      setstrV(L, L->top++, lj_str_new(L, G(L)->tmpbuf.buf, (size_t)len));
+      lj_gc_check(L);
+      return 1;
+    }
+  }
+usebuf:
   luaL_buffinit(L, &b);
   if (i <= e) {
     for (;;) {
@@ -910,6 +910,13 @@ LUA_API void lua_rawseti(lua_State *L, int idx, int n)
   L->top = src;
 }
 
+LUA_API void lua_cleartable(lua_State *L, int idx)
+{
+  cTValue *o = index2adr(L, idx);
+  api_check(L, tvistab(o));
+  lj_tab_clear(tabV(o));
+}
+
 LUA_API int lua_setmetatable(lua_State *L, int idx)
 {
   global_State *g;
@@ -1118,6 +1125,37 @@ LUA_API int lua_dump(lua_State *L, lua_Writer writer, void *data)
 
 /* -- GC and memory management -------------------------------------------- */
 
+static void gc_setstat(lua_State *L, GCtab *t, const char *k, double v)
+{
+  setnumV(lj_tab_setstr(L, t, lj_str_newz(L, k)), v);
+}
+
+static void gc_pushstats(lua_State *L, const GCStats *st)
+{
+  static const char *const states[] = {
+    "pause", "propagate", "sweepstring", "sweep", "finalize", "atomic"
+  };
+  GCtab *t = lj_tab_new(L, 0, hsize2hbits(12));
+  GCtab *tt;
+  int i;
+  settabV(L, L->top, t);
+  incr_top(L);
+  gc_setstat(L, t, "steps", (double)st->steps);
+  gc_setstat(L, t, "cycles", (double)st->cycles);
+  gc_setstat(L, t, "full", (double)st->full);
+  gc_setstat(L, t, "minor", 0);
+  gc_setstat(L, t, "finalized", (double)st->finalized);
+  gc_setstat(L, t, "debt", st->debt);
+  gc_setstat(L, t, "marked", st->marked);
+  gc_setstat(L, t, "freed", st->freed);
+  gc_setstat(L, t, "time", st->total);
+  gc_setstat(L, t, "maxpause", st->maxpause);
+  tt = lj_tab_new(L, 0, hsize2hbits(6));
+  settabV(L, lj_tab_setstr(L, t, lj_str_newlit(L, "phases")), tt);
+  for (i = 0; i < 6; i++)
+    gc_setstat(L, tt, states[i], st->time[i]);
+}
+
 LUA_API int lua_gc(lua_State *L, int what, int data)
 {
   global_State *g = G(L);
@@ -1156,6 +1194,15 @@ LUA_API int lua_gc(lua_State *L, int what, int data)
     res = cast_int(g->gc.stepmul);
     g->gc.stepmul = (MSize)data;
     break;
+  case LUA_GCSTEPTIME:  /* Budget in microseconds. */
+    res = lj_gc_steptime(L, (double)data * 1e-6);
+    break;
+  case LUA_GCSTATS:  /* Push a table with the statistics. */
+    lj_gc_check(L);
+    gc_pushstats(L, &g->gc.stats);
+    if (data != 0)
+      lj_gc_resetstats(g);
+    break;
   default:
     res = -1;  /* Invalid option. */
   }
@@ -128,6 +128,18 @@ typedef uintptr_t BloomFilter;
 #define LJ_UNLIKELY(x)	__builtin_expect(!!(x), 0)
 
 #define lj_ffs(x)	((uint32_t)__builtin_ctz(x))
+
+typedef union __attribute__((packed)) Unaligned32 {
+  uint32_t u;
+  uint8_t b[4];
+} Unaligned32;
+
+/* Unaligned load of uint32_t. */
+static LJ_AINLINE uint32_t lj_getu32(const void *p)
+{
+  return ((const Unaligned32 *)p)->u;
+}
+
 /* Don't ask ... */
 #if defined(__INTEL_COMPILER) && (defined(__i386__) || defined(__x86_64__))
 static LJ_AINLINE uint32_t lj_fls(uint32_t x)
@@ -170,6 +182,8 @@ static LJ_AINLINE uint32_t lj_fls(uint32_t x)
 
 #define lj_bswap(x)	(_byteswap_ulong((x)))
 
+#define lj_getu32(p)	(*(const uint32_t *)(p))
+
 #else
 #error "missing defines for your compiler"
 #endif
@@ -68,6 +68,7 @@ ERRDEF(UNPACK,	"too many results to unpack")
 ERRDEF(RDRSTR,	"reader function must return a string")
 ERRDEF(PRTOSTR,	LUA_QL("tostring") " must return a string to " LUA_QL("print"))
 ERRDEF(IDXRNG,	"index out of range")
+ERRDEF(SIZERNG,	"size out of range")
 ERRDEF(BASERNG,	"base out of range")
 ERRDEF(LVLRNG,	"level out of range")
 ERRDEF(INVLVL,	"invalid level")
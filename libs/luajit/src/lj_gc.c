@@ -9,6 +9,8 @@
 #define lj_gc_c
 #define LUA_CORE
 
+#include <time.h>
+
 #include "lj_obj.h"
 #include "lj_gc.h"
 #include "lj_err.h"
@@ -349,6 +351,7 @@ static size_t gc_propagate_gray(global_State *g)
   size_t m = 0;
   while (gcref(g->gc.gray) != NULL)
     m += propagatemark(g);
+  g->gc.stats.marked += (double)m;
   return m;
 }
 
@@ -357,7 +360,8 @@ static size_t gc_propagate_gray(global_State *g)
 /* Try to shrink some common data structures. */
 static void gc_shrink(global_State *g, lua_State *L)
 {
-  if (g->strnum <= (g->strmask >> 2) && g->strmask > LJ_MIN_STRTAB*2-1)
+  if (g->strnum <= (lj_str_limit(g->strmask) >> 2) &&
+      g->strmask > LJ_MIN_STRTAB*2-1)
     lj_str_resize(L, g->strmask >> 1);  /* Shrink string table. */
   if (g->tmpbuf.sz > LJ_MIN_SBUF*2)
     lj_str_resizebuf(L, &g->tmpbuf, g->tmpbuf.sz >> 1);  /* Shrink temp buf. */
@@ -481,6 +485,7 @@ static void gc_finalize(lua_State *L)
     ptrdiff_t oldjb = 0;
     int errcode;
     TValue *top;
+    g->gc.stats.finalized++;
     if (oldjl) {
       oldjs = gco2th(oldjl)->stacksize;
       oldjb = savestack(gco2th(oldjl), mref(g->jit_base, TValue ));
@@ -526,6 +531,51 @@ void lj_gc_freeall(global_State *g)
     gc_fullsweep(g, &g->strhash[i]);
 }
 
+/* -- Statistics ---------------------------------------------------------- */
+
+/* Time stamp in seconds. */
+static double gc_clock(void)
+{
+#if defined(LUA_USE_POSIX) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#else
+  return (double)clock() * (1.0/(double)CLOCKS_PER_SEC);
+#endif
+}
+
+/* Charge the time since the last charge to a GC state. */
+static void gc_charge(global_State *g, int state)
+{
+  double now = gc_clock();
+  g->gc.stats.time[state] += now - g->gc.stats.mark;
+  g->gc.stats.mark = now;
+}
+
+/* Start timing a GC step or a full GC cycle. */
+static double gc_pausestart(global_State *g)
+{
+  return (g->gc.stats.mark = gc_clock());
+}
+
+/* Finish timing a GC step or a full GC cycle. */
+static void gc_pauseend(global_State *g, double start)
+{
+  double t;
+  gc_charge(g, g->gc.state);
+  t = g->gc.stats.mark - start;
+  g->gc.stats.total += t;
+  if (t > g->gc.stats.maxpause)
+    g->gc.stats.maxpause = t;
+}
+
+/* Reset the GC statistics. */
+void lj_gc_resetstats(global_State *g)
+{
+  memset(&g->gc.stats, 0, sizeof(GCStats));
+}
+
 /* -- Collector ----------------------------------------------------------- */
 
 /* Atomic part of the GC cycle, transitioning from mark to sweep phase. */
@@ -569,20 +619,29 @@ static size_t gc_onestep(lua_State *L)
   global_State *g = G(L);
   switch (g->gc.state) {
   case GCSpause:
+    gc_charge(g, GCSpause);
     gc_mark_start(g);  /* Start a new GC cycle by marking all GC roots. */
     return 0;
   case GCSpropagate:
-    if (gcref(g->gc.gray) != NULL)
-      return propagatemark(g);  /* Propagate one gray object. */
+    if (gcref(g->gc.gray) != NULL) {
+      size_t m = propagatemark(g);  /* Propagate one gray object. */
+      g->gc.stats.marked += (double)m;
+      return m;
+    }
+    gc_charge(g, GCSpropagate);
     atomic(g, L);  /* End of mark phase. */
+    gc_charge(g, GCSatomic);
     return 0;
   case GCSsweepstring: {
     MSize old = g->gc.total;
     gc_fullsweep(g, &g->strhash[g->gc.sweepstr++]);  /* Sweep one chain. */
-    if (g->gc.sweepstr > g->strmask)
+    if (g->gc.sweepstr > g->strmask) {
+      gc_charge(g, GCSsweepstring);
       g->gc.state = GCSsweep;  /* All string hash chains sweeped. */
+    }
     lua_assert(old >= g->gc.total);
     g->gc.estimate -= old - g->gc.total;
+    g->gc.stats.freed += (double)(old - g->gc.total);
     return GCSWEEPCOST;
     }
   case GCSsweep: {
@@ -590,10 +649,12 @@ static size_t gc_onestep(lua_State *L)
     g->gc.sweep = gc_sweep(g, g->gc.sweep, GCSWEEPMAX);  /* Partial sweep. */
     if (gcref(*g->gc.sweep) == NULL) {
       gc_shrink(g, L);
+      gc_charge(g, GCSsweep);
       g->gc.state = GCSfinalize;  /* End of sweep phase. */
     }
     lua_assert(old >= g->gc.total);
     g->gc.estimate -= old - g->gc.total;
+    g->gc.stats.freed += (double)(old - g->gc.total);
     return GCSWEEPMAX*GCSWEEPCOST;
     }
   case GCSfinalize:
@@ -603,8 +664,10 @@ static size_t gc_onestep(lua_State *L)
 	g->gc.estimate -= GCFINALIZECOST;
       return GCFINALIZECOST;
     }
+    gc_charge(g, GCSfinalize);
     g->gc.state = GCSpause;  /* End of GC cycle. */
     g->gc.debt = 0;
+    g->gc.stats.cycles++;
     return 0;
   default:
     lua_assert(0);
@@ -617,17 +680,22 @@ int lj_gc_step(lua_State *L)
 {
   global_State *g = G(L);
   MSize lim;
+  double start;
   int32_t ostate = g->vmstate;
   setvmstate(g, GC);
   lim = (GCSTEPSIZE/100) * g->gc.stepmul;
   if (lim == 0)
     lim = LJ_MAX_MEM;
   g->gc.debt += g->gc.total - g->gc.threshold;
+  g->gc.stats.steps++;
+  g->gc.stats.debt += (double)(g->gc.total - g->gc.threshold);
+  start = gc_pausestart(g);
   do {
     lim -= (MSize)gc_onestep(L);
     if (g->gc.state == GCSpause) {
       lua_assert(g->gc.total >= g->gc.estimate);
       g->gc.threshold = (g->gc.estimate/100) * g->gc.pause;
+      gc_pauseend(g, start);
       g->vmstate = ostate;
       return 1;  /* Finished a GC cycle. */
     }
@@ -638,10 +706,50 @@ int lj_gc_step(lua_State *L)
     g->gc.debt -= GCSTEPSIZE;
     g->gc.threshold = g->gc.total;
   }
+  gc_pauseend(g, start);
   g->vmstate = ostate;
   return 0;
 }
 
+/* Perform GC work until the time budget (in seconds) is used up.
+** The clock is only read every GCSTEPSIZE units of work. A stopped
+** collector stays stopped. Returns 1 at the end of a GC cycle.
+*/
+int lj_gc_steptime(lua_State *L, double budget)
+{
+  global_State *g = G(L);
+  MSize threshold = g->gc.threshold;
+  MSize work = 0;
+  double start, now;
+  int32_t ostate = g->vmstate;
+  setvmstate(g, GC);
+  g->gc.stats.steps++;
+  now = start = gc_pausestart(g);
+  do {
+    work += (MSize)gc_onestep(L);
+    if (g->gc.state == GCSpause)
+      break;
+    if (work >= GCSTEPSIZE) {
+      work = 0;
+      now = gc_clock();
+    }
+  } while (now - start < budget);
+  if (g->gc.state == GCSpause) {
+    lua_assert(g->gc.total >= g->gc.estimate);
+    g->gc.threshold = (g->gc.estimate/100) * g->gc.pause;
+  } else if (g->gc.debt < GCSTEPSIZE) {
+    g->gc.threshold = g->gc.total + GCSTEPSIZE;
+  } else {
+    g->gc.debt -= GCSTEPSIZE;
+    g->gc.threshold = g->gc.total;
+  }
+  if (threshold == LJ_MAX_MEM)
+    g->gc.threshold = LJ_MAX_MEM;
+  gc_pauseend(g, start);
+  g->vmstate = ostate;
+  return (g->gc.state == GCSpause);
+}
+
 /* Ditto, but fix the stack top first. */
 void lj_gc_step_fixtop(lua_State *L)
 {
@@ -663,7 +771,9 @@ void lj_gc_fullgc(lua_State *L)
 {
   global_State *g = G(L);
   int32_t ostate = g->vmstate;
+  double start = gc_pausestart(g);
   setvmstate(g, GC);
+  g->gc.stats.full++;
   if (g->gc.state <= GCSpropagate) {  /* Caught somewhere in the middle. */
     g->gc.sweepstr = 0;
     g->gc.sweep = &g->gc.root;  /* Sweep everything (preserving it). */
@@ -682,6 +792,7 @@ void lj_gc_fullgc(lua_State *L)
   while (g->gc.state != GCSpause)
     gc_onestep(L);
   g->gc.threshold = (g->gc.estimate/100) * g->gc.pause;
+  gc_pauseend(g, start);
   g->vmstate = ostate;
 }
 
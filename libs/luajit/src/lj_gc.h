@@ -11,6 +11,9 @@
 /* Garbage collector states. Order matters. */
 enum { GCSpause, GCSpropagate, GCSsweepstring, GCSsweep, GCSfinalize };
 
+/* Not a state: the atomic part of the mark phase is timed on its own. */
+#define GCSatomic	(GCSfinalize+1)
+
 /* Bitmasks for marked field of GCobj. */
 #define LJ_GC_WHITE0	0x01
 #define LJ_GC_WHITE1	0x02
@@ -43,9 +46,11 @@ LJ_FUNC size_t lj_gc_separateudata(global_State *g, int all);
 LJ_FUNC void lj_gc_finalizeudata(lua_State *L);
 LJ_FUNC void lj_gc_freeall(global_State *g);
 LJ_FUNCA int lj_gc_step(lua_State *L);
+LJ_FUNC int lj_gc_steptime(lua_State *L, double budget);
 LJ_FUNCA void lj_gc_step_fixtop(lua_State *L);
 LJ_FUNCA void lj_gc_step_jit(lua_State *L, const BCIns *pc, MSize steps);
 LJ_FUNC void lj_gc_fullgc(lua_State *L);
+LJ_FUNC void lj_gc_resetstats(global_State *g);
 
 /* GC check: drive collector forward if the GC threshold has been reached. */
 #define lj_gc_check(L) \
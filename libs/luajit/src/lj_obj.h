@@ -498,6 +498,21 @@ MMDEF(MMENUM)
 
 #define BASEMT_MAX	((~LJ_TNUMX)+1)
 
+/* Garbage collector statistics. */
+typedef struct GCStats {
+  uint64_t steps;	/* Number of incremental steps. */
+  uint64_t cycles;	/* Number of finished GC cycles. */
+  uint64_t full;	/* Number of full GC cycles. */
+  uint64_t finalized;	/* Number of finalizers called. */
+  double debt;		/* Bytes allocated over the threshold when steps ran. */
+  double marked;	/* Bytes traversed by the mark phase. */
+  double freed;		/* Bytes freed by the sweep phases. */
+  double total;		/* Time spent in the GC (in seconds). */
+  double maxpause;	/* Longest single GC step or full GC cycle. */
+  double time[6];	/* Time spent in each GC state, plus atomic. */
+  double mark;		/* Time stamp of the last charge to a state. */
+} GCStats;
+
 typedef struct GCState {
   MSize total;		/* Memory currently allocated. */
   MSize threshold;	/* Memory threshold. */
@@ -516,6 +531,7 @@ typedef struct GCState {
   MSize debt;		/* Debt (how much GC is behind schedule). */
   MSize estimate;	/* Estimate of memory actually in use. */
   MSize pause;		/* Pause between successive GC cycles. */
+  GCStats stats;	/* Statistics. */
 } GCState;
 
 /* Global state, shared by all threads of a Lua universe. */
@@ -523,6 +539,7 @@ typedef struct global_State {
   GCRef *strhash;	/* String hash table (hash chain anchors). */
   MSize strmask;	/* String hash mask (size of hash table - 1). */
   MSize strnum;		/* Number of strings in hash table. */
+  uint32_t strseed;	/* Random seed for string hashes. */
   lua_Alloc allocf;	/* Memory allocator. */
   void *allocd;		/* Memory allocator data. */
   GCState gc;		/* Garbage collector. */
@@ -6,6 +6,8 @@
 ** Copyright (C) 1994-2008 Lua.org, PUC-Rio. See Copyright Notice in lua.h
 */
 
+#include <time.h>
+
 #define lj_state_c
 #define LUA_CORE
 
@@ -158,6 +160,23 @@ static void close_state(lua_State *L)
   }
 }
 
+/* Random seed for string hashes: mix the time with addresses (ASLR). */
+static uint32_t state_seed(global_State *g)
+{
+  uint32_t h = (uint32_t)time(NULL);
+  uintptr_t a[3];
+  int i;
+  a[0] = (uintptr_t)g;
+  a[1] = (uintptr_t)&h;
+  a[2] = (uintptr_t)&lua_newstate;
+  for (i = 0; i < 3; i++) {
+    h ^= (uint32_t)a[i];
+    h = (h ^ (h >> 15)) * 0x2c1b3c6du;
+    h = (h ^ (h >> 12)) * 0x297a2d39u;
+  }
+  return h ^ (h >> 15);
+}
+
 LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud)
 {
   GG_State *GG = cast(GG_State *, f(ud, NULL, 0, sizeof(GG_State)));
@@ -176,6 +195,7 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud)
   setgcref(g->uvhead.prev, obj2gco(&g->uvhead));
   setgcref(g->uvhead.next, obj2gco(&g->uvhead));
   g->strmask = ~(MSize)0;
+  g->strseed = state_seed(g);
   setnilV(registry(L));
   setnilV(&g->nilnode.val);
   setnilV(&g->nilnode.key);
@@ -69,6 +69,33 @@ void lj_str_resize(lua_State *L, MSize newmask)
   g->strhash = newhash;
 }
 
+/* Mix 32 bits into the string hash (a MurmurHash3 round). */
+#define str_hashmix(h, k) \
+  (k *= 0xcc9e2d51u, k = lj_rol(k, 15), k *= 0x1b873593u, \
+   h ^= k, h = lj_rol(h, 13), h = h*5 + 0xe6546b64u)
+
+/* Hash all bytes of a string. The per-state seed decides what collides. */
+static LJ_AINLINE MSize str_hash(global_State *g, const char *str, MSize len)
+{
+  uint32_t h = g->strseed ^ len;
+  uint32_t k;
+  const char *e = str + (len & ~(MSize)3);
+  for (; str < e; str += 4) {
+    k = lj_getu32(str);
+    str_hashmix(h, k);
+  }
+  k = 0;
+  switch (len & 3) {  /* Mix remaining bytes. */
+  case 3: k ^= (uint32_t)(uint8_t)str[2] << 16;  /* fallthrough */
+  case 2: k ^= (uint32_t)(uint8_t)str[1] << 8;  /* fallthrough */
+  case 1: k ^= (uint32_t)(uint8_t)str[0]; str_hashmix(h, k);
+  }
+  h ^= h >> 16; h *= 0x85ebca6bu;  /* Final avalanche. */
+  h ^= h >> 13; h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
 /* Intern a string and return string object. */
 GCstr *lj_str_new(lua_State *L, const char *str, size_t lenx)
 {
@@ -76,15 +103,12 @@ GCstr *lj_str_new(lua_State *L, const char *str, size_t lenx)
   GCstr *s;
   GCobj *o;
   MSize len = (MSize)lenx;
-  MSize h = len;
-  MSize step = (len>>5)+1;  /* Partial hash. */
-  MSize l1;
+  MSize h;
   if (lenx >= LJ_MAX_STR)
     lj_err_msg(L, LJ_ERR_STROV);
-  for (l1 = len; l1 >= step; l1 -= step)  /* Compute string hash. */
-    h = h ^ ((h<<5)+(h>>2)+cast(unsigned char, str[l1-1]));
-  /* Check if the string has already been interned. */
   g = G(L);
+  h = str_hash(g, str, len);
+  /* Check if the string has already been interned. */
   for (o = gcref(g->strhash[h & g->strmask]); o != NULL; o = gcnext(o)) {
     GCstr *tso = gco2str(o);
     if (tso->len == len && (memcmp(str, strdata(tso), len) == 0)) {
@@ -106,7 +130,7 @@ GCstr *lj_str_new(lua_State *L, const char *str, size_t lenx)
   s->nextgc = g->strhash[h];
   /* NOBARRIER: The string table is a GC root. */
   setgcref(g->strhash[h], obj2gco(s));
-  if (g->strnum++ > g->strmask)  /* Allow a 100% load factor. */
+  if (g->strnum++ >= lj_str_limit(g->strmask))  /* See LUAI_STRLOAD. */
     lj_str_resize(L, (g->strmask<<1)+1);  /* Grow string table. */
   return s;  /* Return newly interned string. */
 }
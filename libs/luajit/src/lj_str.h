@@ -16,6 +16,10 @@ LJ_FUNC void lj_str_resize(lua_State *L, MSize newmask);
 LJ_FUNCA GCstr *lj_str_new(lua_State *L, const char *str, size_t len);
 LJ_FUNC void LJ_FASTCALL lj_str_free(global_State *g, GCstr *s);
 
+/* Max. number of strings for a string table size, see LUAI_STRLOAD. */
+#define lj_str_limit(mask) \
+  ((MSize)(((uint64_t)(mask)+1) * LUAI_STRLOAD / 100))
+
 #define lj_str_newz(L, s)	(lj_str_new(L, s, strlen(s)))
 #define lj_str_newlit(L, s)	(lj_str_new(L, "" s, sizeof(s)-1))
 
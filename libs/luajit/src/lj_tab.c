@@ -199,6 +199,19 @@ GCtab *lj_tab_dup(lua_State *L, const GCtab *kt)
   return t;
 }
 
+/* Clear a table in place, keeping the array and hash parts.
+** Only references are dropped, so this needs no GC barrier.
+*/
+void LJ_FASTCALL lj_tab_clear(GCtab *t)
+{
+  clearapart(t);
+  if (t->hmask > 0) {
+    Node *node = noderef(t->node);
+    clearhpart(t);
+    setmref(t->lastfree, &node[t->hmask+1]);
+  }
+}
+
 /* Free a table. */
 void LJ_FASTCALL lj_tab_free(global_State *g, GCtab *t)
 {
@@ -0,0 +1,374 @@
+#include "benchmark.hpp"
+#include "luainc.hpp"
+#include "timer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+namespace
+{
+	BenchCase make_case(const char * name, const char * path, BenchCase::Kind kind, int iterations, const char * arg1 = 0)
+	{
+		BenchCase bc;
+		bc.name = name;
+		bc.path = path;
+		bc.kind = kind;
+		bc.iterations = iterations;
+		bc.max_warmup = -1;
+		bc.max_repetitions = -1;
+		if(arg1)
+			bc.args.push_back(arg1);
+		return bc;
+	}
+
+	std::vector<BenchCase> make_suite()
+	{
+		std::vector<BenchCase> suite;
+		suite.push_back(make_case("fib", "libs/lua/test/fib.lua", BenchCase::Script, 1, "24"));
+		suite.push_back(make_case("sieve", "libs/lua/test/sieve.lua", BenchCase::Script, 10));
+		suite.push_back(make_case("life", "libs/lua/test/life.lua", BenchCase::Script, 1));
+		suite.push_back(make_case("sort", "libs/lua/test/sort.lua", BenchCase::Script, 1000));
+		suite.push_back(make_case("luabins", "libs/luabins/etc/benchmark.lua", BenchCase::BenchTable, 100000));
+		// bitbench grows its loops until every operation runs for a second, one pass takes ~20s
+		BenchCase bitbench = make_case("bitbench", "libs/luabitop/bitbench.lua", BenchCase::Script, 1);
+		bitbench.max_warmup = 0;
+		bitbench.max_repetitions = 3;
+		suite.push_back(bitbench);
+		suite.push_back(make_case("nsievebits", "libs/luabitop/nsievebits.lua", BenchCase::Script, 10));
+		suite.push_back(make_case("intern", "src/test/intern.lua", BenchCase::BenchTable, 10));
+		suite.push_back(make_case("sortarray", "src/test/sortarray.lua", BenchCase::BenchTable, 1));
+		suite.push_back(make_case("concat", "src/test/concat.lua", BenchCase::BenchTable, 10));
+		suite.push_back(make_case("patterns", "src/test/patterns.lua", BenchCase::BenchTable, 10));
+		suite.push_back(make_case("find", "src/test/find.lua", BenchCase::BenchTable, 10));
+		suite.push_back(make_case("rules", "src/test/rules.lua", BenchCase::BenchTable, 10));
+		suite.push_back(make_case("objects", "src/test/objects.lua", BenchCase::BenchTable, 10));
+		suite.push_back(make_case("gc", "src/test/gc.lua", BenchCase::BenchTable, 5));
+		suite.push_back(make_case("gcgen", "src/test/gc.lua", BenchCase::BenchTable, 5, "generational"));
+		return suite;
+	}
+
+	int bench_silent(lua_State *)
+	{
+		return 0;
+	}
+
+	lua_State * bench_open(const BenchCase & bc, const BenchOptions & opt, const std::string & path)
+	{
+		lua_State * L = luaL_newstate();
+		if(!L)
+			return 0;
+		luaL_openlibs(L);
+
+		lua_getglobal(L, "package");
+		lua_pushstring(L, opt.cpath.c_str());
+		lua_setfield(L, -2, "cpath");
+		lua_pop(L, 1);
+
+		if(!opt.verbose)
+		{
+			lua_pushcfunction(L, bench_silent);
+			lua_setglobal(L, "print");
+			lua_getglobal(L, "io");
+			lua_pushcfunction(L, bench_silent);
+			lua_setfield(L, -2, "write");
+			lua_pop(L, 1);
+		}
+
+		// sieve.lua still calls math.mod, which luaconf.h no longer provides
+		lua_getglobal(L, "math");
+		lua_getfield(L, -1, "mod");
+		if(lua_isnil(L, -1))
+		{
+			lua_getfield(L, -2, "fmod");
+			lua_setfield(L, -3, "mod");
+		}
+		lua_pop(L, 2);
+
+		lua_createtable(L, int(bc.args.size()), 1);
+		lua_pushstring(L, path.c_str());
+		lua_rawseti(L, -2, 0);
+		for(size_t i = 0; i < bc.args.size(); ++i)
+		{
+			lua_pushstring(L, bc.args[i].c_str());
+			lua_rawseti(L, -2, int(i + 1));
+		}
+		lua_setglobal(L, "arg");
+		return L;
+	}
+
+	std::string pop_error(lua_State * L)
+	{
+		const char * msg = lua_tostring(L, -1);
+		std::string error = msg ? msg : "(error object is not a string)";
+		lua_pop(L, 1);
+		return error;
+	}
+
+	// calls the function referenced by ref iterations times, returns elapsed seconds or -1 on error
+	double bench_sample(lua_State * L, int ref, int iterations, std::string & error)
+	{
+		lua_gc(L, LUA_GCCOLLECT, 0);
+		double start = timer_now();
+		for(int i = 0; i < iterations; ++i)
+		{
+			lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+			if(lua_pcall(L, 0, 0, 0) != 0)
+			{
+				error = pop_error(L);
+				return -1.0;
+			}
+		}
+		return timer_now() - start;
+	}
+
+	int capped(int value, int cap)
+	{
+		return (cap >= 0 && cap < value) ? cap : value;
+	}
+
+	void bench_measure(lua_State * L, int ref, const BenchCase & bc, const BenchOptions & opt, BenchResult & result)
+	{
+		int warmup = capped(opt.warmup, bc.max_warmup);
+		int repetitions = capped(opt.repetitions, bc.max_repetitions);
+		for(int i = 0; i < warmup; ++i)
+		{
+			if(bench_sample(L, ref, result.iterations, result.error) < 0)
+				return;
+		}
+		for(int i = 0; i < repetitions; ++i)
+		{
+			double elapsed = bench_sample(L, ref, result.iterations, result.error);
+			if(elapsed < 0)
+				return;
+			result.samples.push_back(elapsed / result.iterations);
+		}
+	}
+
+	bool bench_selected(const BenchOptions & opt, const std::string & name)
+	{
+		return opt.filter.empty() || name.find(opt.filter) != std::string::npos;
+	}
+
+	std::vector<double> sorted(const std::vector<double> & samples)
+	{
+		std::vector<double> s(samples);
+		std::sort(s.begin(), s.end());
+		return s;
+	}
+
+	void write_json_string(std::ostream & os, const std::string & str)
+	{
+		static const char hex[] = "0123456789abcdef";
+		os << '"';
+		for(size_t i = 0; i < str.size(); ++i)
+		{
+			unsigned char c = static_cast<unsigned char>(str[i]);
+			switch(c)
+			{
+			case '"': os << "\\\""; break;
+			case '\\': os << "\\\\"; break;
+			case '\n': os << "\\n"; break;
+			case '\r': os << "\\r"; break;
+			case '\t': os << "\\t"; break;
+			default:
+				if(c < 0x20)
+					os << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+				else
+					os << c;
+			}
+		}
+		os << '"';
+	}
+}
+
+double BenchResult::min() const
+{
+	if(samples.empty())
+		return 0.0;
+	return *std::min_element(samples.begin(), samples.end());
+}
+
+double BenchResult::median() const
+{
+	if(samples.empty())
+		return 0.0;
+	std::vector<double> s = sorted(samples);
+	size_t n = s.size();
+	return (n % 2) ? s[n / 2] : (s[n / 2 - 1] + s[n / 2]) / 2.0;
+}
+
+double BenchResult::p99() const
+{
+	if(samples.empty())
+		return 0.0;
+	// nearest rank
+	std::vector<double> s = sorted(samples);
+	size_t rank = size_t(std::ceil(0.99 * double(s.size())));
+	return s[rank > 0 ? rank - 1 : 0];
+}
+
+double BenchResult::mean() const
+{
+	if(samples.empty())
+		return 0.0;
+	double sum = 0.0;
+	for(size_t i = 0; i < samples.size(); ++i)
+		sum += samples[i];
+	return sum / double(samples.size());
+}
+
+BenchOptions::BenchOptions()
+	: warmup(1)
+	, repetitions(10)
+	, root(LUACMAKE_SOURCE_DIR)
+#if defined(WIN32)
+	, cpath(LUACMAKE_MODULE_DIR "/?.dll")
+#else
+	, cpath(LUACMAKE_MODULE_DIR "/lib?.so;" LUACMAKE_MODULE_DIR "/?.so")
+#endif
+	, verbose(false)
+{
+}
+
+const std::vector<BenchCase> & bench_suite()
+{
+	static const std::vector<BenchCase> suite = make_suite();
+	return suite;
+}
+
+void bench_run(const BenchCase & bc, const BenchOptions & opt, std::vector<BenchResult> & results)
+{
+	if(bc.kind == BenchCase::Script && !bench_selected(opt, bc.name))
+		return;
+
+	std::string path = opt.root + "/" + bc.path;
+
+	BenchResult failure;
+	failure.name = bc.name;
+	failure.iterations = bc.iterations;
+
+	lua_State * L = bench_open(bc, opt, path);
+	if(!L)
+	{
+		failure.error = "cannot create lua state";
+		results.push_back(failure);
+		return;
+	}
+
+	if(luaL_loadfile(L, path.c_str()) != 0)
+	{
+		failure.error = pop_error(L);
+		results.push_back(failure);
+		lua_close(L);
+		return;
+	}
+
+	if(bc.kind == BenchCase::Script)
+	{
+		int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		BenchResult result;
+		result.name = bc.name;
+		result.iterations = bc.iterations;
+		bench_measure(L, ref, bc, opt, result);
+		results.push_back(result);
+		lua_close(L);
+		return;
+	}
+
+	if(lua_pcall(L, 0, 1, 0) != 0)
+	{
+		failure.error = pop_error(L);
+		results.push_back(failure);
+		lua_close(L);
+		return;
+	}
+	if(!lua_istable(L, -1))
+	{
+		failure.error = "benchmark script did not return a table";
+		results.push_back(failure);
+		lua_close(L);
+		return;
+	}
+
+	// run the functions in name order, so reports are stable between runs
+	std::vector<std::string> names;
+	lua_pushnil(L);
+	while(lua_next(L, -2) != 0)
+	{
+		if(lua_type(L, -2) == LUA_TSTRING && lua_isfunction(L, -1))
+			names.push_back(lua_tostring(L, -2));
+		lua_pop(L, 1);
+	}
+	std::sort(names.begin(), names.end());
+
+	for(size_t i = 0; i < names.size(); ++i)
+	{
+		BenchResult result;
+		result.name = bc.name + "." + names[i];
+		result.iterations = bc.iterations;
+		if(!bench_selected(opt, result.name))
+			continue;
+		lua_getfield(L, -1, names[i].c_str());
+		int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		bench_measure(L, ref, bc, opt, result);
+		luaL_unref(L, LUA_REGISTRYINDEX, ref);
+		results.push_back(result);
+	}
+	lua_close(L);
+}
+
+void bench_write_json(std::ostream & os, const BenchOptions & opt, const std::vector<BenchResult> & results)
+{
+	os << std::setprecision(9);
+	os << "{\n";
+	os << "  \"engine\": \"" << LUACMAKE_ENGINE << "\",\n";
+	os << "  \"version\": \"" << LUACMAKE_ENGINE_VERSION << "\",\n";
+	os << "  \"warmup\": " << opt.warmup << ",\n";
+	os << "  \"repetitions\": " << opt.repetitions << ",\n";
+	os << "  \"unit\": \"s\",\n";
+	os << "  \"results\": [";
+	for(size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchResult & r = results[i];
+		os << (i ? ",\n" : "\n") << "    {\"name\": ";
+		write_json_string(os, r.name);
+		os << ", \"iterations\": " << r.iterations;
+		os << ", \"samples\": " << r.samples.size();
+		if(!r.samples.empty())
+		{
+			os << ", \"min\": " << r.min();
+			os << ", \"median\": " << r.median();
+			os << ", \"p99\": " << r.p99();
+			os << ", \"mean\": " << r.mean();
+		}
+		if(!r.error.empty())
+		{
+			os << ", \"error\": ";
+			write_json_string(os, r.error);
+		}
+		os << "}";
+	}
+	os << "\n  ]\n}\n";
+}
+
+void bench_write_text(std::ostream & os, const BenchOptions & opt, const std::vector<BenchResult> & results)
+{
+	os << LUACMAKE_ENGINE_VERSION << ", warmup " << opt.warmup << ", repetitions " << opt.repetitions
+		<< ", times in us per iteration\n";
+	os << std::setw(24) << "name" << " |" << std::setw(14) << "min" << " |" << std::setw(14) << "median"
+		<< " |" << std::setw(14) << "p99" << "\n";
+	os << std::fixed << std::setprecision(3);
+	for(size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchResult & r = results[i];
+		os << std::setw(24) << r.name << " |";
+		if(!r.error.empty())
+		{
+			os << " error: " << r.error << "\n";
+			continue;
+		}
+		os << std::setw(14) << r.min() * 1e6 << " |" << std::setw(14) << r.median() * 1e6
+			<< " |" << std::setw(14) << r.p99() * 1e6 << "\n";
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef BENCHMARK_HPP_
+#define BENCHMARK_HPP_
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+// one entry of the fixed benchmark suite
+struct BenchCase
+{
+	enum Kind
+	{
+		Script,   // whole chunk is the workload, rerun per iteration
+		BenchTable // chunk returns a table of name -> function, every function is a separate workload
+	};
+
+	std::string name;
+	std::string path;          // relative to source root
+	Kind kind;
+	int iterations;            // workload runs per timed sample
+	int max_warmup;            // caps for self-calibrating scripts, -1 means no cap
+	int max_repetitions;
+	std::vector<std::string> args; // passed to the script as global arg
+};
+
+// timings of one workload, in seconds per iteration
+struct BenchResult
+{
+	std::string name;
+	int iterations;
+	std::vector<double> samples;
+	std::string error;
+
+	double min() const;
+	double median() const;
+	double p99() const;
+	double mean() const;
+};
+
+struct BenchOptions
+{
+	int warmup;
+	int repetitions;
+	std::string root;    // source tree holding the suite scripts
+	std::string cpath;   // package.cpath used to find bit, luabins, ...
+	std::string filter;  // run only workloads whose name contains filter
+	bool verbose;        // keep print/io.write output of the scripts
+
+	BenchOptions();
+};
+
+const std::vector<BenchCase> & bench_suite();
+
+// runs a suite entry, appending one result per workload
+void bench_run(const BenchCase & bc, const BenchOptions & opt, std::vector<BenchResult> & results);
+
+void bench_write_json(std::ostream & os, const BenchOptions & opt, const std::vector<BenchResult> & results);
+void bench_write_text(std::ostream & os, const BenchOptions & opt, const std::vector<BenchResult> & results);
+
+#endif /* BENCHMARK_HPP_ */
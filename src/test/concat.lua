@@ -0,0 +1,40 @@
+-- table.concat building responses of different shapes.
+
+local table_concat, string_rep = table.concat, string.rep
+
+-- 20000 short header-like lines, ~400k result
+local lines = {}
+for i = 1, 20000 do
+  lines[i] = "X-Header-" .. i .. ": value " .. i .. "\r\n"
+end
+
+-- 500 chunks of 1k, ~500k result
+local chunks = {}
+for i = 1, 500 do
+  chunks[i] = string_rep(string.char(65 + i % 26), 1024)
+end
+
+-- fits into one buffer
+local fields = {}
+for i = 1, 10 do
+  fields[i] = "field" .. i
+end
+
+return
+{
+  lines = function()
+    return table_concat(lines)
+  end;
+
+  chunks = function()
+    return table_concat(chunks)
+  end;
+
+  small = function()
+    local s
+    for i = 1, 1000 do
+      s = table_concat(fields, ",")
+    end
+    return s
+  end;
+}
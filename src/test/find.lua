@@ -0,0 +1,49 @@
+-- plain string.find over large payloads, as done by protocol parsers.
+
+local string_find, string_rep = string.find, string.rep
+
+-- ~2MB of http-like messages separated by a blank line
+local parts = {}
+for i = 1, 10000 do
+  parts[i] = "POST /api/v1/items/" .. i .. " HTTP/1.1\r\nHost: example.com\r\n" ..
+             "Content-Type: text/plain\r\nX-Request-Id: " .. i * 7919 .. "\r\n\r\n" ..
+             string_rep("payload ", 20)
+end
+local payload = table.concat(parts)
+
+-- repetitive haystack, needle with a common prefix
+local repetitive = string_rep("a", 1000000) .. "b"
+local needle = string_rep("a", 100) .. "b"
+
+local function count(s, delim)
+  local n, pos = 0, 1
+  while true do
+    local a, b = string_find(s, delim, pos, true)
+    if not a then return n end
+    n = n + 1
+    pos = b + 1
+  end
+end
+
+return
+{
+  delimiter = function()
+    return count(payload, "\r\n\r\n")
+  end;
+
+  word = function()
+    return count(payload, "X-Request-Id: ")
+  end;
+
+  repetitive = function()
+    return string_find(repetitive, needle, 1, true)
+  end;
+
+  prefix = function()
+    local n = 0
+    for id in payload:gmatch("X%-Request%-Id: (%d+)") do
+      n = n + 1
+    end
+    return n
+  end;
+}
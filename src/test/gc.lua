@@ -0,0 +1,32 @@
+-- short-lived garbage next to a large, mostly static heap.
+-- arg[1] selects the collector mode ("incremental" by default); engines
+-- without a generational mode keep their default collector.
+
+local collectgarbage = collectgarbage
+
+local mode = arg and arg[1] or "incremental"
+pcall(collectgarbage, mode)
+
+-- ~100MB of long-lived configuration-like data
+local static = {}
+for i = 1, 300000 do
+  static[i] = { id = i, name = "item" .. i, tags = { "a" .. i % 97, "b" .. i % 89 } }
+end
+
+return
+{
+  -- requests built from the static data and thrown away, with a few
+  -- updates of the old data going through the write barriers
+  churn = function()
+    local n, size = 0, #static
+    for i = 1, 200000 do
+      local item = static[i % size + 1]
+      local req = { item = item, path = { item.name, item.tags[1] } }
+      n = n + #req.path
+    end
+    for i = 1, 1000 do
+      static[i * 97 % size + 1].last = { i }
+    end
+    return n
+  end;
+}
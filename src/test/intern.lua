@@ -0,0 +1,34 @@
+-- String interning cost for short and long keys.
+-- Every workload creates and keeps 2000 new strings, so each intern walks
+-- the string table chains that the previous strings built.
+
+local N = 2000
+local string_format, string_rep = string.format, string.rep
+
+local prefix = "http://example.com/api/v1/resource?session="
+  .. string_rep("0123456789abcdef", 4) .. "&id="
+
+-- 224 chars: the default hash samples every 8th char counting from the
+-- end, so keys that differ only in chars 2..6 land in the same chain
+local filler = string_rep("x", 224 - 6)
+
+local intern = function(make)
+  return function()
+    local t = {}
+    for i = 1, N do
+      t[i] = make(i)
+    end
+    return t
+  end
+end
+
+return
+{
+  short = intern(function(i) return "k" .. i end);
+
+  long = intern(function(i) return prefix .. i end);
+
+  long_similar = intern(function(i)
+    return "/" .. string_format("%05d", i) .. filler
+  end);
+}
@@ -0,0 +1,31 @@
+#ifndef LUAINC_HPP_
+#define LUAINC_HPP_
+
+// lua headers for the selected engine. lua built as c++ (WITH_LUACPP) must not be wrapped in extern "C"
+
+#if defined(WITHLUAJIT)
+extern "C" {
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+#include "luajit.h"
+}
+#define LUACMAKE_ENGINE "luajit"
+#define LUACMAKE_ENGINE_VERSION LUAJIT_VERSION
+#elif defined(WITHLUACPP)
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+#define LUACMAKE_ENGINE "lua"
+#define LUACMAKE_ENGINE_VERSION LUA_RELEASE
+#else
+extern "C" {
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+}
+#define LUACMAKE_ENGINE "lua"
+#define LUACMAKE_ENGINE_VERSION LUA_RELEASE
+#endif
+
+#endif /* LUAINC_HPP_ */
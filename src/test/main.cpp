@@ -1,11 +1,119 @@
 #include <iostream>
+#include <fstream>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "benchmark.hpp"
+
+namespace
+{
+	void usage(const char * program)
+	{
+		std::cout << "usage: " << program << " [options]\n"
+			<< "  --warmup=N       untimed runs of every workload (default 1)\n"
+			<< "  --reps=N         timed runs of every workload (default 10)\n"
+			<< "  --filter=TEXT    run only workloads whose name contains TEXT\n"
+			<< "  --root=PATH      source tree holding the suite scripts\n"
+			<< "  --cpath=PATH     package.cpath for bit, luabins, ...\n"
+			<< "  --json[=FILE]    write machine readable results to stdout or FILE\n"
+			<< "  --verbose        keep output of the benchmark scripts\n"
+			<< "  --list           list suite entries and exit\n";
+	}
+
+	bool option(const char * arg, const char * name, const char * & value)
+	{
+		size_t len = std::strlen(name);
+		if(std::strncmp(arg, name, len) != 0)
+			return false;
+		if(arg[len] == '\0')
+		{
+			value = 0;
+			return true;
+		}
+		if(arg[len] != '=')
+			return false;
+		value = arg + len + 1;
+		return true;
+	}
+}
 
 int main(int argc, char** argv)
 {
 	std::srand(time(0));
 	try
 	{
+		BenchOptions opt;
+		bool json = false;
+		std::string json_file;
+
+		for(int i = 1; i < argc; ++i)
+		{
+			const char * value = 0;
+			if(option(argv[i], "--warmup", value) && value)
+				opt.warmup = std::atoi(value);
+			else if(option(argv[i], "--reps", value) && value)
+				opt.repetitions = std::atoi(value);
+			else if(option(argv[i], "--filter", value) && value)
+				opt.filter = value;
+			else if(option(argv[i], "--root", value) && value)
+				opt.root = value;
+			else if(option(argv[i], "--cpath", value) && value)
+				opt.cpath = value;
+			else if(option(argv[i], "--json", value))
+			{
+				json = true;
+				json_file = value ? value : "";
+			}
+			else if(option(argv[i], "--verbose", value) && !value)
+				opt.verbose = true;
+			else if(option(argv[i], "--list", value) && !value)
+			{
+				const std::vector<BenchCase> & suite = bench_suite();
+				for(size_t j = 0; j < suite.size(); ++j)
+					std::cout << suite[j].name << "\t" << suite[j].path << "\n";
+				return 0;
+			}
+			else
+			{
+				usage(argv[0]);
+				return std::strcmp(argv[i], "--help") == 0 ? 0 : 1;
+			}
+		}
+
+		if(opt.warmup < 0 || opt.repetitions < 1)
+		{
+			std::cerr << "warmup must be >= 0 and reps >= 1\n";
+			return 1;
+		}
+
+		std::vector<BenchResult> results;
+		const std::vector<BenchCase> & suite = bench_suite();
+		for(size_t i = 0; i < suite.size(); ++i)
+			bench_run(suite[i], opt, results);
+
+		bool failed = false;
+		for(size_t i = 0; i < results.size(); ++i)
+		{
+			if(!results[i].error.empty())
+				failed = true;
+		}
+
+		if(!json)
+			bench_write_text(std::cout, opt, results);
+		else if(json_file.empty())
+			bench_write_json(std::cout, opt, results);
+		else
+		{
+			std::ofstream out(json_file.c_str());
+			if(!out)
+			{
+				std::cerr << "cannot open " << json_file << "\n";
+				return 1;
+			}
+			bench_write_json(out, opt, results);
+		}
+		return failed ? 2 : 0;
 	}
 	catch(std::exception & e)
 	{
@@ -19,4 +127,3 @@ int main(int argc, char** argv)
 	}
 	return 0;
 }
-
@@ -0,0 +1,101 @@
+-- Method calls on objects with metatable-based classes: every call
+-- misses in the instance and resolves the method through __index, one
+-- to five levels up.
+
+local N = 1000
+
+local Account = {}
+Account.__index = Account
+
+function Account.new(balance)
+  return setmetatable({ balance = balance, ops = 0 }, Account)
+end
+
+function Account:deposit(v)
+  self.balance = self.balance + v
+  self.ops = self.ops + 1
+end
+
+function Account:get()
+  return self.balance
+end
+
+local Savings = setmetatable({}, { __index = Account })
+Savings.__index = Savings
+
+function Savings.new(balance, rate)
+  local o = Account.new(balance)
+  o.rate = rate
+  return setmetatable(o, Savings)
+end
+
+function Savings:interest()
+  return self:get() * self.rate
+end
+
+-- a domain-model style hierarchy, five classes deep
+local Entity = {}
+Entity.__index = Entity
+function Entity:id() return self.key end
+function Entity:kind() return "entity" end
+
+local function subclass(base)
+  local c = setmetatable({}, base)
+  c.__index = c
+  return c
+end
+
+local Party = subclass(Entity)
+local Person = subclass(Party)
+local Customer = subclass(Person)
+local Premium = subclass(Customer)
+function Premium:discount() return 0.1 end
+
+local accounts, savings, customers = {}, {}, {}
+for i = 1, N do
+  accounts[i] = Account.new(i)
+  savings[i] = Savings.new(i, i / 1000)
+  customers[i] = setmetatable({ key = i }, Premium)
+end
+
+return
+{
+  -- methods found in the class of the instance
+  direct = function()
+    local s = 0
+    for rep = 1, 20 do
+      for i = 1, N do
+        local a = accounts[i]
+        a:deposit(1)
+        s = s + a:get()
+      end
+    end
+    return s
+  end;
+
+  -- methods inherited from the base class
+  inherited = function()
+    local s = 0
+    for rep = 1, 20 do
+      for i = 1, N do
+        local a = savings[i]
+        a:deposit(1)
+        s = s + a:interest()
+      end
+    end
+    return s
+  end;
+
+  -- methods and missing fields resolved along a deep hierarchy
+  deep = function()
+    local s = 0
+    for rep = 1, 20 do
+      for i = 1, N do
+        local c = customers[i]
+        s = s + c:id() + c:discount()
+        if c.nickname == nil and c:kind() == "entity" then s = s + 1 end
+      end
+    end
+    return s
+  end;
+}
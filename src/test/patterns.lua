@@ -0,0 +1,49 @@
+-- string.find/match/gmatch/gsub with constant patterns in parser-like loops.
+
+local string_find, string_match, string_gmatch, string_gsub =
+      string.find, string.match, string.gmatch, string.gsub
+
+-- 2000 "key = value" lines, some comments and blanks
+local lines = {}
+for i = 1, 2000 do
+  if i % 10 == 0 then
+    lines[i] = "# comment " .. i
+  elseif i % 17 == 0 then
+    lines[i] = "   "
+  else
+    lines[i] = "  key_" .. i .. " = value " .. i * 3 .. "  "
+  end
+end
+
+local text = table.concat(lines, "\n")
+
+return
+{
+  match = function()
+    local n = 0
+    for i = 1, #lines do
+      local line = lines[i]
+      if not string_find(line, "^%s*#") and string_find(line, "%S") then
+        local k, v = string_match(line, "^%s*([%w_]+)%s*=%s*(.-)%s*$")
+        if k then n = n + #v end
+      end
+    end
+    return n
+  end;
+
+  gmatch = function()
+    local n = 0
+    for word in string_gmatch(text, "[%a_][%w_]*") do
+      n = n + 1
+    end
+    for num in string_gmatch(text, "%d+") do
+      n = n + 1
+    end
+    return n
+  end;
+
+  gsub = function()
+    local s = string_gsub(text, "%s+", " ")
+    return string_gsub(s, "key_(%d+)", "%1")
+  end;
+}
@@ -0,0 +1,41 @@
+-- Numeric rules over records: field reads with constant keys, arithmetic
+-- with constants and numeric comparisons, the instruction mix of most
+-- business logic.
+
+local N = 1000
+
+local records = {}
+for i = 1, N do
+  records[i] = { limit = i * 10, rate = i / 100, count = i % 7, name = "r" .. i }
+end
+
+return
+{
+  -- filter and aggregate over the fields of every record
+  score = function()
+    local acc = 0
+    for rep = 1, 20 do
+      for i = 1, N do
+        local r = records[i]
+        local v = r.limit - 5 + rep
+        if v > 100 and r.rate < 5 then
+          acc = acc + r.rate * 2 - 1
+        elseif r.count <= 3 then
+          acc = acc - r.count + 0.5
+        end
+      end
+    end
+    return acc
+  end;
+
+  -- running totals written back into the records
+  update = function()
+    for rep = 1, 20 do
+      for i = 1, N do
+        local r = records[i]
+        r.count = r.count + 1
+        if r.count >= 10 then r.count = r.count - 10 end
+      end
+    end
+  end;
+}
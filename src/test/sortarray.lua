@@ -0,0 +1,44 @@
+-- table.sort on large arrays. Every workload sorts a fresh copy of the
+-- same 100000 values, the copy is part of the measured time.
+
+local N = 100000
+local table_sort, table_stablesort = table.sort, table.stablesort
+
+math.randomseed(1)
+
+local numbers, ascending, strings = {}, {}, {}
+for i = 1, N do
+  numbers[i] = math.random()
+  ascending[i] = i
+  strings[i] = tostring(math.random(1, N))
+end
+
+local sorter = function(src, sort, cmp)
+  return function()
+    local t = {}
+    for i = 1, N do
+      t[i] = src[i]
+    end
+    sort(t, cmp)
+    return t
+  end
+end
+
+local less = function(a, b) return a < b end
+
+return
+{
+  numbers = sorter(numbers, table_sort);
+
+  ascending = sorter(ascending, table_sort);
+
+  strings = sorter(strings, table_sort);
+
+  cmp = sorter(numbers, table_sort, less);
+
+  -- luajit has no table.stablesort
+  stable = table_stablesort and sorter(strings, table_stablesort);
+
+  stable_cmp = table_stablesort
+    and sorter(numbers, table_stablesort, less);
+}
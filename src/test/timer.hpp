@@ -0,0 +1,30 @@
+#ifndef TIMER_HPP_
+#define TIMER_HPP_
+
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+// monotonic wall clock in seconds
+inline double timer_now()
+{
+#if defined(WIN32)
+	LARGE_INTEGER freq, counter;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&counter);
+	return double(counter.QuadPart) / double(freq.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return double(ts.tv_sec) + double(ts.tv_nsec) * 1e-9;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return double(tv.tv_sec) + double(tv.tv_usec) * 1e-6;
+#endif
+}
+
+#endif /* TIMER_HPP_ */